@@ -39,6 +39,7 @@ class LoggerImpl
 __thread char t_errnobuf[512];
 __thread char t_time[64];
 __thread time_t t_lastSecond;
+__thread const Timestamp *t_logClock = NULL;
 
 // 将 errno 转化为 字符串
 const char *strerror_tl(int savedErrno)
@@ -125,7 +126,7 @@ using namespace muduo;
 
 // 实现类 构造函数
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile &file, int line)
-    : time_(Timestamp::now()),
+    : time_(t_logClock ? *t_logClock : Timestamp::now()),
       stream_(),
       level_(level),
       line_(line),
@@ -244,3 +245,8 @@ void Logger::setTimeZone(const TimeZone &tz)
 {
   g_logTimeZone = tz;
 }
+
+void Logger::setThreadClock(const Timestamp *time)
+{
+  t_logClock = time;
+}
@@ -88,6 +88,9 @@ public:
   static void setFlush(FlushFunc);
   // 设置时区
   static void setTimeZone(const TimeZone &tz);
+  // 本线程的日志时间取自 *time，而不是每行读一次时钟，NULL 恢复
+  // e.g. the cached clock of an EventLoop, see EventLoop::setClockMode()
+  static void setThreadClock(const Timestamp *time);
 
 private:
   // Logger 实现类
@@ -0,0 +1,191 @@
+// 无锁的多生产者单消费者队列，节点由调用者分配（侵入式）
+
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+
+///
+/// Intrusive multi-producer single-consumer queue.
+///
+/// T has a member 'std::atomic<T*> next' owned by the queue while T is in it.
+/// Producers push with a compare-and-swap, the consumer takes everything
+/// pushed so far with one exchange, so no element is ever half-linked.
+///
+template<typename T>
+class MpscQueue : noncopyable
+{
+ public:
+  MpscQueue()
+    : head_(NULL),
+      size_(0)
+  {
+  }
+
+  /// Safe to call from any thread.
+  /// @return true if the queue was empty.
+  bool push(T* node)
+  {
+    // counted before it is visible, so size() never goes below zero
+    size_.fetch_add(1, std::memory_order_relaxed);
+    T* head = head_.load(std::memory_order_relaxed);
+    do
+    {
+      node->next.store(head, std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, node,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed));
+    return head == NULL;
+  }
+
+  /// Consumer only.  Takes all elements, linked by 'next' in push order.
+  /// @return NULL if empty.
+  T* popAll()
+  {
+    T* node = head_.exchange(NULL, std::memory_order_seq_cst);
+    // 栈顶是最后一个，反转成先进先出
+    T* first = NULL;
+    size_t n = 0;
+    while (node)
+    {
+      T* next = node->next.load(std::memory_order_relaxed);
+      node->next.store(first, std::memory_order_relaxed);
+      first = node;
+      node = next;
+      ++n;
+    }
+    size_.fetch_sub(n, std::memory_order_relaxed);
+    return first;
+  }
+
+  bool empty() const
+  {
+    return head_.load(std::memory_order_seq_cst) == NULL;
+  }
+
+  /// Approximate when producers are running.
+  size_t size() const
+  {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<T*> head_;    // most recently pushed
+  std::atomic<size_t> size_;
+};
+
+///
+/// Lock-free stack of free nodes of a MpscQueue, so that producers don't
+/// allocate.  The consumer puts nodes back, any thread gets them.
+///
+/// A node is never freed while the pool lives, get() may read 'next' of a
+/// node another thread has just taken.  The pool holds as many nodes as
+/// were in use at the same time.
+///
+template<typename T>
+class MpscNodePool : noncopyable
+{
+ public:
+  MpscNodePool()
+    : head_(0),
+      size_(0)
+  {
+  }
+
+  ~MpscNodePool()
+  {
+    T* node = pointerOf(head_.load(std::memory_order_relaxed));
+    while (node)
+    {
+      T* next = node->next.load(std::memory_order_relaxed);
+      delete node;
+      node = next;
+    }
+  }
+
+  /// Safe to call from any thread.
+  /// @return NULL if empty.
+  T* get()
+  {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (T* node = pointerOf(head))
+    {
+      T* next = node->next.load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head, pack(next, tagOf(head)),
+                                      std::memory_order_acquire,
+                                      std::memory_order_acquire))
+      {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return node;
+      }
+    }
+    return NULL;
+  }
+
+  /// Consumer only, the node must not be in use.
+  /// @return false if it is not kept, the caller deletes it.
+  bool put(T* node)
+  {
+    if (reinterpret_cast<uintptr_t>(node) > kPointerMask)
+    {
+      return false;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do
+    {
+      node->next.store(pointerOf(head), std::memory_order_relaxed);
+      // 每次放回都改变标记，get() 不会被 ABA 骗过
+    } while (!head_.compare_exchange_weak(head, pack(node, tagOf(head) + 1),
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+    return true;
+  }
+
+  size_t size() const
+  {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // x86-64 and aarch64 user space addresses fit in 48 bits,
+  // the other 16 count put() calls
+  static const int kPointerBits = 48;
+  static const uint64_t kPointerMask = (uint64_t(1) << kPointerBits) - 1;
+
+  static T* pointerOf(uint64_t head)
+  {
+    return reinterpret_cast<T*>(static_cast<uintptr_t>(head & kPointerMask));
+  }
+
+  static uint64_t tagOf(uint64_t head)
+  {
+    return head >> kPointerBits;
+  }
+
+  static uint64_t pack(T* node, uint64_t tag)
+  {
+    return reinterpret_cast<uintptr_t>(node) | (tag << kPointerBits);
+  }
+
+  static_assert(sizeof(void*) == 8, "needs 64-bit pointers");
+  std::atomic<uint64_t> head_;    // pointer and tag
+  std::atomic<size_t> size_;
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_MPSCQUEUE_H
@@ -0,0 +1,241 @@
+// 只能移动的 void() 函数对象，比 std::function 有更大的内部存储，避免堆分配
+
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_TASK_H
+#define MUDUO_BASE_TASK_H
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <stddef.h>
+
+namespace muduo
+{
+
+///
+/// Move-only callable taking no argument, like std::function<void()>.
+///
+/// Callables of up to kInlineSize bytes are stored inside the Task, e.g.
+/// a std::bind of a member function with a shared_ptr, or with a raw
+/// pointer and a string.  libstdc++'s std::function stores 16 bytes,
+/// so each of those is a heap allocation there.
+/// Larger callables, or those which may throw when moved, go to the heap.
+///
+class Task
+{
+ public:
+  static const size_t kInlineSize = 56;   // sizeof(Task) is 64
+
+  Task() noexcept
+    : ops_(NULL)
+  {
+  }
+
+  Task(std::nullptr_t) noexcept
+    : ops_(NULL)
+  {
+  }
+
+  template<typename F,
+           typename Callable = typename std::decay<F>::type,
+           typename = typename std::enable_if<!std::is_same<Callable, Task>::value>::type,
+           typename = decltype(std::declval<Callable&>()())>
+  Task(F&& f)
+    : ops_(NULL)
+  {
+    if (!NullCheck<Callable>::isNull(f))
+    {
+      init<Callable>(std::forward<F>(f),
+                     std::integral_constant<bool, storedInline<Callable>()>());
+    }
+  }
+
+  Task(Task&& rhs) noexcept
+    : ops_(rhs.ops_)
+  {
+    if (ops_)
+    {
+      ops_->relocate(storage_, rhs.storage_);
+      rhs.ops_ = NULL;
+    }
+  }
+
+  Task& operator=(Task&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      reset();
+      if (rhs.ops_)
+      {
+        rhs.ops_->relocate(storage_, rhs.storage_);
+        ops_ = rhs.ops_;
+        rhs.ops_ = NULL;
+      }
+    }
+    return *this;
+  }
+
+  Task& operator=(std::nullptr_t) noexcept
+  {
+    reset();
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task()
+  {
+    reset();
+  }
+
+  /// Like std::function, calls a non-const operator() of the callable.
+  void operator()() const
+  {
+    assert(ops_ != NULL);
+    ops_->invoke(storage_);
+  }
+
+  explicit operator bool() const noexcept
+  {
+    return ops_ != NULL;
+  }
+
+  /// Whether a callable of type F is stored without heap allocation.
+  template<typename F>
+  static constexpr bool storedInline()
+  {
+    return sizeof(F) <= kInlineSize
+        && alignof(F) <= alignof(void*)
+        && std::is_nothrow_move_constructible<F>::value;
+  }
+
+ private:
+  struct Ops
+  {
+    void (*invoke)(void* storage);
+    // move-constructs at dst, then destroys src
+    void (*relocate)(void* dst, void* src);
+    void (*destroy)(void* storage);
+  };
+
+  template<typename F>
+  struct InlineOps
+  {
+    static void invoke(void* storage)
+    {
+      (*static_cast<F*>(storage))();
+    }
+
+    static void relocate(void* dst, void* src)
+    {
+      F* f = static_cast<F*>(src);
+      new (dst) F(std::move(*f));
+      f->~F();
+    }
+
+    static void destroy(void* storage)
+    {
+      static_cast<F*>(storage)->~F();
+    }
+
+    static const Ops ops;
+  };
+
+  // storage_ holds a F*
+  template<typename F>
+  struct HeapOps
+  {
+    static F* get(void* storage)
+    {
+      return *static_cast<F**>(storage);
+    }
+
+    static void invoke(void* storage)
+    {
+      (*get(storage))();
+    }
+
+    static void relocate(void* dst, void* src)
+    {
+      new (dst) F*(get(src));
+    }
+
+    static void destroy(void* storage)
+    {
+      delete get(storage);
+    }
+
+    static const Ops ops;
+  };
+
+  // empty std::function and null function pointers make an empty Task
+  template<typename F>
+  struct NullCheck
+  {
+    static bool isNull(const F&) { return false; }
+  };
+
+  template<typename R, typename... Args>
+  struct NullCheck<R (*)(Args...)>
+  {
+    static bool isNull(R (*f)(Args...)) { return f == NULL; }
+  };
+
+  template<typename R, typename... Args>
+  struct NullCheck<std::function<R (Args...)>>
+  {
+    static bool isNull(const std::function<R (Args...)>& f) { return !f; }
+  };
+
+  template<typename Callable, typename F>
+  void init(F&& f, std::true_type /* inline */)
+  {
+    new (storage_) Callable(std::forward<F>(f));
+    ops_ = &InlineOps<Callable>::ops;
+  }
+
+  template<typename Callable, typename F>
+  void init(F&& f, std::false_type /* inline */)
+  {
+    new (storage_) Callable*(new Callable(std::forward<F>(f)));
+    ops_ = &HeapOps<Callable>::ops;
+  }
+
+  void reset() noexcept
+  {
+    if (ops_)
+    {
+      ops_->destroy(storage_);
+      ops_ = NULL;
+    }
+  }
+
+  const Ops* ops_;
+  alignas(void*) mutable char storage_[kInlineSize];
+};
+
+template<typename F>
+const Task::Ops Task::InlineOps<F>::ops = {
+  &Task::InlineOps<F>::invoke,
+  &Task::InlineOps<F>::relocate,
+  &Task::InlineOps<F>::destroy,
+};
+
+template<typename F>
+const Task::Ops Task::HeapOps<F>::ops = {
+  &Task::HeapOps<F>::invoke,
+  &Task::HeapOps<F>::relocate,
+  &Task::HeapOps<F>::destroy,
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_TASK_H
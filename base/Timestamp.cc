@@ -7,6 +7,7 @@
 
 #include <sys/time.h>
 #include <stdio.h>
+#include <time.h>
 
 #ifndef __STDC_FORMAT_MACROS
 #define __STDC_FORMAT_MACROS
@@ -66,3 +67,20 @@ Timestamp Timestamp::now()
   return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
+// 粗粒度时钟，只读取内核最近一次 tick 的时间
+Timestamp Timestamp::nowCoarse()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  int64_t seconds = ts.tv_sec;
+  return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+int64_t Timestamp::coarseResolution()
+{
+  struct timespec ts;
+  clock_getres(CLOCK_REALTIME_COARSE, &ts);
+  int64_t seconds = ts.tv_sec;
+  return seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
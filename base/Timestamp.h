@@ -65,6 +65,13 @@ class Timestamp : public muduo::copyable,
   /// Get time of now.
   ///
   static Timestamp now();
+  ///
+  /// Get time of now from CLOCK_REALTIME_COARSE, cheaper than now(),
+  /// but it lags by up to coarseResolution().
+  ///
+  static Timestamp nowCoarse();
+  /// Tick of nowCoarse() in microseconds, usually 1 to 10 ms.
+  static int64_t coarseResolution();
   // 返回一个无效的 timestamp
   static Timestamp invalid()
   {
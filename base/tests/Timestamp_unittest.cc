@@ -55,6 +55,29 @@ void benchmark()
   }
 }
 
+// now() 与 nowCoarse() 的开销
+void benchmarkCoarse()
+{
+  const int kNumber = 1000*1000;
+  int64_t sum = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < kNumber; ++i)
+  {
+    sum += Timestamp::now().microSecondsSinceEpoch();
+  }
+  Timestamp middle(Timestamp::now());
+  for (int i = 0; i < kNumber; ++i)
+  {
+    sum += Timestamp::nowCoarse().microSecondsSinceEpoch();
+  }
+  Timestamp end(Timestamp::now());
+  printf("now() %.1f ns, nowCoarse() %.1f ns, coarse resolution %d us (%d)\n",
+         timeDifference(middle, start) * 1e9 / kNumber,
+         timeDifference(end, middle) * 1e9 / kNumber,
+         static_cast<int>(Timestamp::coarseResolution()),
+         static_cast<int>(sum & 1));
+}
+
 int main()
 {
   Timestamp now(Timestamp::now());
@@ -62,5 +85,6 @@ int main()
   passByValue(now);
   passByConstReference(now);
   benchmark();
+  benchmarkCoarse();
 }
 
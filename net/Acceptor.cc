@@ -57,6 +57,11 @@ void Acceptor::listen()
   acceptChannel_.enableReading();
 }
 
+InetAddress Acceptor::localAddress() const
+{
+  return InetAddress(sockets::getLocalAddr(acceptSocket_.fd()));
+}
+
 // 新连接处理
 void Acceptor::handleRead()
 {
@@ -43,6 +43,8 @@ class Acceptor : noncopyable
 
   bool listenning() const { return listenning_; }
   void listen();
+  /// 绑定后的地址，端口 0 时由内核选择
+  InetAddress localAddress() const;
 
  private:
   void handleRead();
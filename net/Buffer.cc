@@ -9,6 +9,7 @@
 
 #include "muduo/net/Buffer.h"
 
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/SocketsOps.h"
 
 #include <errno.h>
@@ -23,10 +24,190 @@ const char Buffer::kCRLF[] = "\r\n";
 // 在头文件中 声明并定义
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
+const size_t Buffer::kMaxReadHint;
+
+Buffer::Buffer(Buffer&& rhs) noexcept
+  : buffer_(std::move(rhs.buffer_)),
+    readerIndex_(rhs.readerIndex_),
+    writerIndex_(rhs.writerIndex_),
+    pool_(NULL),
+    readHint_(kInitialSize)
+{
+  if (rhs.pool_ && !buffer_.empty())
+  {
+    rhs.pool_->disown(buffer_.size());
+  }
+  rhs.readerIndex_ = 0;
+  rhs.writerIndex_ = 0;
+}
+
+std::vector<char> Buffer::takeStorage(size_t* begin, size_t* end)
+{
+  if (pool_ && !buffer_.empty())
+  {
+    pool_->disown(buffer_.size());
+  }
+  *begin = readerIndex_;
+  *end = writerIndex_;
+  std::vector<char> storage;
+  storage.swap(buffer_);
+  readerIndex_ = 0;
+  writerIndex_ = 0;
+  return storage;
+}
+
+Buffer& Buffer::operator=(const Buffer& rhs)
+{
+  if (this != &rhs)
+  {
+    Buffer copy(rhs);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+Buffer& Buffer::operator=(Buffer&& rhs) noexcept
+{
+  if (this == &rhs)
+  {
+    return *this;
+  }
+  if (pool_)
+  {
+    releaseStorage();
+  }
+  if (rhs.pool_ != pool_ && !rhs.buffer_.empty())
+  {
+    if (rhs.pool_)
+    {
+      rhs.pool_->disown(rhs.buffer_.size());
+    }
+    if (pool_)
+    {
+      pool_->adopt(rhs.buffer_.size());
+    }
+  }
+  buffer_ = std::move(rhs.buffer_);
+  readerIndex_ = rhs.readerIndex_;
+  writerIndex_ = rhs.writerIndex_;
+  rhs.buffer_.clear();
+  rhs.readerIndex_ = 0;
+  rhs.writerIndex_ = 0;
+  return *this;
+}
+
+void Buffer::releaseStorage()
+{
+  assert(pool_);
+  if (!buffer_.empty())
+  {
+    pool_->release(&buffer_);
+    readerIndex_ = 0;
+    writerIndex_ = 0;
+  }
+}
+
+void Buffer::setPool(BufferPool* pool)
+{
+  if (pool == pool_)
+  {
+    return;
+  }
+  if (pool_ && !buffer_.empty())
+  {
+    pool_->disown(buffer_.size());
+  }
+  pool_ = pool;
+  if (pool_ && !buffer_.empty())
+  {
+    if (readableBytes() == 0)
+    {
+      // storage was not borrowed from the pool, just free it.
+      std::vector<char>().swap(buffer_);
+      readerIndex_ = 0;
+      writerIndex_ = 0;
+    }
+    else
+    {
+      pool_->adopt(buffer_.size());
+    }
+  }
+}
+
+void Buffer::releaseToPool()
+{
+  if (pool_ && readableBytes() == 0)
+  {
+    releaseStorage();
+  }
+}
+
+void Buffer::reallocate(size_t len)
+{
+  const size_t readable = readableBytes();
+  std::vector<char> storage;
+  if (pool_)
+  {
+    storage = pool_->acquire(kCheapPrepend + readable + len);
+  }
+  else
+  {
+    storage.resize(kCheapPrepend + readable + std::max(len, kInitialSize));
+  }
+  if (readable > 0)
+  {
+    ::memcpy(storage.data() + kCheapPrepend, peek(), readable);
+  }
+  if (pool_)
+  {
+    pool_->release(&buffer_);
+  }
+  buffer_.swap(storage);
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = kCheapPrepend + readable;
+}
+
+// 从内存池借用足够的空间，数据直接读入 buffer，每个字节只拷贝一次
+ssize_t Buffer::readFdInPlace(int fd, int* savedErrno)
+{
+  assert(pool_);
+  ensureWritableBytes(readHint_);
+  const size_t writable = writableBytes();
+  const ssize_t n = sockets::read(fd, beginWrite(), writable);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    writerIndex_ += n;
+    // adapt to the traffic: a full read means more is likely waiting,
+    // a small one means we can borrow a smaller block next time.
+    const size_t nread = implicit_cast<size_t>(n);
+    if (nread == writable)
+    {
+      readHint_ = std::min(2 * writable, kMaxReadHint);
+    }
+    else if (nread < readHint_ / 4)
+    {
+      readHint_ = std::max(readHint_ / 2, kInitialSize);
+    }
+  }
+  return n;
+}
 
 // 读取 fd 中的数据
 ssize_t Buffer::readFd(int fd, int* savedErrno)
 {
+  if (pool_)
+  {
+    return readFdInPlace(fd, savedErrno);
+  }
+  if (buffer_.empty())
+  {
+    // moved-from, get storage first
+    makeSpace(kInitialSize);
+  }
   // 使用 FIONREAD 获得要读取多少长度
   // saved an ioctl()/FIONREAD call to tell how much to read
   char extrabuf[65536];
@@ -17,6 +17,7 @@
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 
+#include "muduo/net/ByteScan.h"
 #include "muduo/net/Endian.h"
 
 #include <algorithm>
@@ -31,6 +32,8 @@ namespace muduo
 namespace net
 {
 
+class BufferPool;
+
 /// http://www.cnblogs.com/Solstice/archive/2011/04/17/2018801.html 参考链接
 /// A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
 ///
@@ -53,26 +56,56 @@ class Buffer : public muduo::copyable
  public:
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
+  static const size_t kMaxReadHint = 256*1024;
 
   explicit Buffer(size_t initialSize = kInitialSize)
     : buffer_(kCheapPrepend + initialSize),
       readerIndex_(kCheapPrepend),
-      writerIndex_(kCheapPrepend)
+      writerIndex_(kCheapPrepend),
+      pool_(NULL),
+      readHint_(kInitialSize)
   {
     assert(readableBytes() == 0);
     assert(writableBytes() == initialSize);
     assert(prependableBytes() == kCheapPrepend);
   }
 
-  // implicit copy-ctor, move-ctor, dtor and assignment are fine
-  // NOTE: implicit move-ctor is added in g++ 4.6
+  // storage borrowed from pool_ goes back to it.
+  ~Buffer()
+  {
+    if (pool_)
+    {
+      releaseStorage();
+    }
+  }
+
+  // a Buffer keeps its pool_, which belongs to the owner's loop thread,
+  // storage moving between pools is accounted over.
+  // a new Buffer copied or moved to has no pool, it may go to another thread.
+  // a moved-from Buffer has no storage, it re-grows on next append.
+  Buffer(const Buffer& rhs)
+    : buffer_(rhs.buffer_),
+      readerIndex_(rhs.readerIndex_),
+      writerIndex_(rhs.writerIndex_),
+      pool_(NULL),
+      readHint_(kInitialSize)
+  {
+  }
+
+  Buffer(Buffer&& rhs) noexcept;
 
+  Buffer& operator=(const Buffer& rhs);
+
+  Buffer& operator=(Buffer&& rhs) noexcept;
+
+  // pools are exchanged with the storage
   void swap(Buffer& rhs)
   {
     // vector of char
     buffer_.swap(rhs.buffer_);
     std::swap(readerIndex_, rhs.readerIndex_);
     std::swap(writerIndex_, rhs.writerIndex_);
+    std::swap(pool_, rhs.pool_);
   }
 
   // 可读的长度
@@ -92,35 +125,30 @@ class Buffer : public muduo::copyable
   { return begin() + readerIndex_; }
 
   // 从可读数据中读取 换行符
+  // SIMD kernels picked at runtime, see ByteScan.h
   const char* findCRLF() const
   {
-    // FIXME: replace with memmem()?
-    const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    return detail::findCRLF(peek(), beginWrite());
   }
 
   const char* findCRLF(const char* start) const
   {
     assert(peek() <= start);
     assert(start <= beginWrite());
-    // FIXME: replace with memmem()?
-    const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    return detail::findCRLF(start, beginWrite());
   }
 
   const char* findEOL() const
   {
     // 从 buf 所指内存区域的前count个字节查找字符 ch
-    const void* eol = memchr(peek(), '\n', readableBytes());
-    return static_cast<const char*>(eol);
+    return detail::findByte(peek(), beginWrite(), '\n');
   }
 
   const char* findEOL(const char* start) const
   {
     assert(peek() <= start);
     assert(start <= beginWrite());
-    const void* eol = memchr(start, '\n', beginWrite() - start);
-    return static_cast<const char*>(eol);
+    return detail::findByte(start, beginWrite(), '\n');
   }
 
   // retrieve returns void, to prevent
@@ -173,10 +201,16 @@ class Buffer : public muduo::copyable
   // 获取全部，之后 readerIndex_ / writerIndex_ 复位
   void retrieveAll()
   {
-    readerIndex_ = kCheapPrepend;
-    writerIndex_ = kCheapPrepend;
+    // no storage (returned to pool or moved-from), no prepend area either
+    readerIndex_ = buffer_.empty() ? 0 : kCheapPrepend;
+    writerIndex_ = readerIndex_;
   }
 
+  // 取走底层存储，不拷贝数据，用于交给其他线程
+  /// Readable bytes are [*begin, *end) of the returned storage.
+  /// The buffer is left like a moved-from one.
+  std::vector<char> takeStorage(size_t* begin, size_t* end);
+
   // 读取所有的数据 作为 string
   string retrieveAllAsString()
   {
@@ -382,6 +416,10 @@ class Buffer : public muduo::copyable
 
   void prepend(const void* /*restrict*/ data, size_t len)
   {
+    if (buffer_.empty())
+    {
+      makeSpace(0);
+    }
     assert(len <= prependableBytes());
     readerIndex_ -= len;
     const char* d = static_cast<const char*>(data);
@@ -392,6 +430,11 @@ class Buffer : public muduo::copyable
   // 收缩 缓冲区
   void shrink(size_t reserve)
   {
+    if (pool_)
+    {
+      reallocate(reserve);
+      return;
+    }
     // FIXME: use vector::shrink_to_fit() in C++ 11 if possible.
     Buffer other;
     other.ensureWritableBytes(readableBytes()+reserve);
@@ -406,27 +449,52 @@ class Buffer : public muduo::copyable
     return buffer_.capacity();
   }
 
+  ///
+  /// Borrows storage from @c pool when there is data, see releaseToPool().
+  /// Storage holding data stays, and is accounted to @c pool instead.
+  /// Must be called in the loop thread which owns @c pool,
+  /// and the one which owns the current pool.
+  void setPool(BufferPool* pool);
+
+  BufferPool* pool() const
+  { return pool_; }
+
+  ///
+  /// Returns storage to the pool if there is no readable data.
+  /// The buffer has zero capacity afterwards.
+  void releaseToPool();
+
   /// Read data directly into buffer.
   ///
   /// It may implement with readv(2)
+  /// With a pool, it borrows space sized by recent reads and reads
+  /// in place, otherwise overflow goes through a 64KiB stack buffer.
   /// @return result of read(2), @c errno is saved
   ssize_t readFd(int fd, int* savedErrno);
 
  private:
 
   char* begin()
-  { return &*buffer_.begin(); }
+  { return buffer_.data(); }
 
   const char* begin() const
-  { return &*buffer_.begin(); }
+  { return buffer_.data(); }
 
   // 创造空间
   void makeSpace(size_t len)
   {
     if (writableBytes() + prependableBytes() < len + kCheapPrepend)
     {
-      // FIXME: move readable data
-      buffer_.resize(writerIndex_+len);
+      if (pool_ || buffer_.empty())
+      {
+        // 从内存池借用更大的块，或者重新获得存储空间
+        reallocate(len);
+      }
+      else
+      {
+        // FIXME: move readable data
+        buffer_.resize(writerIndex_+len);
+      }
     }
     else
     {
@@ -443,10 +511,19 @@ class Buffer : public muduo::copyable
     }
   }
 
+  // move readable data to new storage with at least len writable bytes
+  void reallocate(size_t len);
+  // gives storage back to pool_, readable data is dropped
+  void releaseStorage();
+
+  ssize_t readFdInPlace(int fd, int* savedErrno);
+
  private:
   std::vector<char> buffer_;        // vecotr 结合 char 构成 buffer 缓冲区
   size_t readerIndex_;              // 读取 索引
   size_t writerIndex_;
+  BufferPool* pool_;                // 借用存储空间的内存池，可以为空
+  size_t readHint_;                 // 下一次 readFd 预留的空间，随读取量自适应
 
   // 类静态数据 用于判断换行字符串
   static const char kCRLF[];
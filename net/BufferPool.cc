@@ -0,0 +1,98 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/BufferPool.h"
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kMinBlockSize;
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kDefaultMaxPooledBytes;
+
+BufferPool::BufferPool(size_t maxPooledBytes)
+  : maxPooledBytes_(maxPooledBytes),
+    pooledBytes_(0),
+    inUseBytes_(0)
+{
+}
+
+BufferPool::~BufferPool() = default;
+
+BufferPool::Block BufferPool::acquire(size_t len)
+{
+  Block block;
+  int sizeClass = 0;
+  while (sizeClass < kNumClasses && blockSize(sizeClass) < len)
+  {
+    ++sizeClass;
+  }
+
+  if (sizeClass < kNumClasses && !freeLists_[sizeClass].empty())
+  {
+    // 从空闲链表取出，不分配内存
+    block.swap(freeLists_[sizeClass].back());
+    freeLists_[sizeClass].pop_back();
+    sub(&pooledBytes_, block.size());
+  }
+  else
+  {
+    block.resize(sizeClass < kNumClasses ? blockSize(sizeClass) : len);
+  }
+  add(&inUseBytes_, block.size());
+  return block;
+}
+
+void BufferPool::release(Block* block)
+{
+  const size_t size = block->size();
+  if (size == 0)
+  {
+    return;
+  }
+  sub(&inUseBytes_, size);
+
+  // put it in the largest class it can serve
+  int sizeClass = -1;
+  while (sizeClass+1 < kNumClasses && blockSize(sizeClass+1) <= size)
+  {
+    ++sizeClass;
+  }
+
+  if (sizeClass >= 0
+      && size <= 2*blockSize(sizeClass)
+      && pooledBytes() + size <= maxPooledBytes_)
+  {
+    freeLists_[sizeClass].push_back(Block());
+    freeLists_[sizeClass].back().swap(*block);
+    add(&pooledBytes_, size);
+  }
+  else
+  {
+    Block().swap(*block);
+  }
+}
+
+void BufferPool::shrink()
+{
+  for (int i = 0; i < kNumClasses; ++i)
+  {
+    std::vector<Block>().swap(freeLists_[i]);
+  }
+  pooledBytes_.store(0, std::memory_order_relaxed);
+}
+
+string BufferPool::toString() const
+{
+  char buf[64];
+  snprintf(buf, sizeof buf, "pooled %zu in-use %zu", pooledBytes(), inUseBytes());
+  return buf;
+}
@@ -0,0 +1,100 @@
+// check 每个 EventLoop 一个的缓冲区内存池，Buffer / ChainBuffer 有数据时借用，空闲时归还
+
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+
+#include <atomic>
+#include <vector>
+
+#include <assert.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Per-EventLoop pool of buffer storage.
+///
+/// Blocks are grouped in power-of-two size classes, starting from
+/// the default size of a Buffer.  Connections borrow blocks when they
+/// have data and return them when drained, so idle connections
+/// cost (almost) no buffer memory.
+///
+/// acquire() and release() must be called in the loop thread,
+/// the statistics can be read from any thread.
+class BufferPool : noncopyable
+{
+ public:
+  typedef std::vector<char> Block;
+
+  static const size_t kMinBlockSize = 1024 + 8;   // Buffer::kCheapPrepend + Buffer::kInitialSize
+  static const int kNumClasses = 13;              // largest pooled block is 4MiB + 32KiB
+  static const size_t kDefaultMaxPooledBytes = 64*1024*1024;
+
+  explicit BufferPool(size_t maxPooledBytes = kDefaultMaxPooledBytes);
+  ~BufferPool();
+
+  /// Returns a block whose size() is at least @c len.
+  Block acquire(size_t len);
+
+  /// Gives back a block, @c block is empty afterwards.
+  /// Blocks beyond maxPooledBytes() are freed.
+  void release(Block* block);
+
+  /// Frees all pooled blocks.
+  void shrink();
+
+  /// Accounts storage a buffer brings from or takes to another owner,
+  /// e.g. a connection moving to another loop, see Buffer::setPool().
+  void adopt(size_t bytes) { add(&inUseBytes_, bytes); }
+  void disown(size_t bytes) { sub(&inUseBytes_, bytes); }
+
+  /// Bytes kept in free lists, ready for reuse.
+  size_t pooledBytes() const { return pooledBytes_.load(std::memory_order_relaxed); }
+  /// Bytes borrowed by buffers and not returned yet.
+  size_t inUseBytes() const { return inUseBytes_.load(std::memory_order_relaxed); }
+
+  size_t maxPooledBytes() const { return maxPooledBytes_; }
+  void setMaxPooledBytes(size_t maxBytes) { maxPooledBytes_ = maxBytes; }
+
+  string toString() const;
+
+ private:
+  static size_t blockSize(int sizeClass)
+  { return kMinBlockSize << sizeClass; }
+
+  // written only in loop thread, so load + store is enough.
+  static void add(std::atomic<size_t>* counter, size_t n)
+  { counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+  static void sub(std::atomic<size_t>* counter, size_t n)
+  {
+    size_t old = counter->load(std::memory_order_relaxed);
+    // buffers give back only what they borrowed or adopted
+    assert(old >= n);
+    counter->store(old - n, std::memory_order_relaxed);
+  }
+
+  std::vector<Block> freeLists_[kNumClasses];
+  size_t maxPooledBytes_;
+  std::atomic<size_t> pooledBytes_;
+  std::atomic<size_t> inUseBytes_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERPOOL_H
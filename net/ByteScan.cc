@@ -0,0 +1,252 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/ByteScan.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MUDUO_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char* detail::findCRLFScalar(const char* begin, const char* end)
+{
+  const char* p = begin;
+  while (p < end)
+  {
+    const char* cr = static_cast<const char*>(::memchr(p, '\r', end - p));
+    if (cr == NULL || cr + 1 >= end)
+    {
+      return NULL;
+    }
+    if (cr[1] == '\n')
+    {
+      return cr;
+    }
+    p = cr + 1;
+  }
+  return NULL;
+}
+
+const char* detail::findByteScalar(const char* begin, const char* end, char c)
+{
+  return begin < end ? static_cast<const char*>(::memchr(begin, c, end - begin)) : NULL;
+}
+
+#if MUDUO_SCAN_X86
+
+// 同时比较 p 处的 '\r' 和 p+1 处的 '\n'，两个掩码相与即为 CRLF 的位置
+const char* detail::findCRLFSse2(const char* begin, const char* end)
+{
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const char* p = begin;
+  for (; end - p >= 17; p += 16)
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr),
+                                               _mm_cmpeq_epi8(b, lf)));
+    if (mask)
+    {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return findCRLFScalar(p, end);
+}
+
+const char* detail::findByteSse2(const char* begin, const char* end, char c)
+{
+  const __m128i v = _mm_set1_epi8(c);
+  const char* p = begin;
+  for (; end - p >= 16; p += 16)
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, v));
+    if (mask)
+    {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  for (; p < end; ++p)
+  {
+    if (*p == c)
+    {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+namespace
+{
+
+__attribute__((target("avx2")))
+const char* findCRLFAvx2Impl(const char* begin, const char* end)
+{
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const char* p = begin;
+  // two blocks per iteration for long lines, e.g. a big header value
+  for (; end - p >= 65; p += 64)
+  {
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 33));
+    __m256i m0 = _mm256_and_si256(_mm256_cmpeq_epi8(a0, cr), _mm256_cmpeq_epi8(b0, lf));
+    __m256i m1 = _mm256_and_si256(_mm256_cmpeq_epi8(a1, cr), _mm256_cmpeq_epi8(b1, lf));
+    if (!_mm256_testz_si256(_mm256_or_si256(m0, m1), _mm256_or_si256(m0, m1)))
+    {
+      unsigned mask0 = static_cast<unsigned>(_mm256_movemask_epi8(m0));
+      if (mask0)
+      {
+        return p + __builtin_ctz(mask0);
+      }
+      return p + 32 + __builtin_ctz(static_cast<unsigned>(_mm256_movemask_epi8(m1)));
+    }
+  }
+  for (; end - p >= 33; p += 32)
+  {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+    if (mask)
+    {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return detail::findCRLFSse2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* findByteAvx2Impl(const char* begin, const char* end, char c)
+{
+  const __m256i v = _mm256_set1_epi8(c);
+  const char* p = begin;
+  for (; end - p >= 32; p += 32)
+  {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, v)));
+    if (mask)
+    {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return detail::findByteSse2(p, end, c);
+}
+
+bool detectAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+bool hasAvx2()
+{
+  static const bool avx2 = detectAvx2();
+  return avx2;
+}
+
+}  // namespace
+
+const char* detail::findCRLFAvx2(const char* begin, const char* end)
+{
+  return hasAvx2() ? findCRLFAvx2Impl(begin, end) : findCRLFSse2(begin, end);
+}
+
+const char* detail::findByteAvx2(const char* begin, const char* end, char c)
+{
+  return hasAvx2() ? findByteAvx2Impl(begin, end, c) : findByteSse2(begin, end, c);
+}
+
+#else  // !MUDUO_SCAN_X86
+
+const char* detail::findCRLFSse2(const char* begin, const char* end)
+{
+  return findCRLFScalar(begin, end);
+}
+
+const char* detail::findCRLFAvx2(const char* begin, const char* end)
+{
+  return findCRLFScalar(begin, end);
+}
+
+const char* detail::findByteSse2(const char* begin, const char* end, char c)
+{
+  return findByteScalar(begin, end, c);
+}
+
+const char* detail::findByteAvx2(const char* begin, const char* end, char c)
+{
+  return findByteScalar(begin, end, c);
+}
+
+#endif  // MUDUO_SCAN_X86
+
+namespace
+{
+
+const char* g_kernelName = "scalar";
+
+// pick kernels once, like an ifunc resolver
+void resolveKernels()
+{
+#if MUDUO_SCAN_X86
+  if (hasAvx2())
+  {
+    detail::g_findCRLF = findCRLFAvx2Impl;
+    detail::g_findByte = findByteAvx2Impl;
+    g_kernelName = "avx2";
+  }
+  else
+  {
+    detail::g_findCRLF = detail::findCRLFSse2;
+    detail::g_findByte = detail::findByteSse2;
+    g_kernelName = "sse2";
+  }
+#else
+  detail::g_findCRLF = detail::findCRLFScalar;
+  detail::g_findByte = detail::findByteScalar;
+#endif
+}
+
+// used until resolveKernels() runs, e.g. from other static initializers
+const char* findCRLFResolve(const char* begin, const char* end)
+{
+  resolveKernels();
+  return detail::g_findCRLF(begin, end);
+}
+
+const char* findByteResolve(const char* begin, const char* end, char c)
+{
+  resolveKernels();
+  return detail::g_findByte(begin, end, c);
+}
+
+struct KernelResolver
+{
+  KernelResolver() { resolveKernels(); }
+};
+
+KernelResolver resolver;
+
+}  // namespace
+
+detail::FindCRLFFunc detail::g_findCRLF = findCRLFResolve;
+detail::FindByteFunc detail::g_findByte = findByteResolve;
+
+const char* detail::scanKernelName()
+{
+  return g_kernelName;
+}
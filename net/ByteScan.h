@@ -0,0 +1,64 @@
+// check 查找 CRLF / LF / 单个字符的 SIMD 实现，运行时根据 CPU 选择 AVX2 / SSE2 / 标量版本
+
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BYTESCAN_H
+#define MUDUO_NET_BYTESCAN_H
+
+namespace muduo
+{
+namespace net
+{
+namespace detail
+{
+
+///
+/// Byte scanning kernels used by Buffer and HttpContext.
+///
+/// All functions search [begin, end) and return NULL if not found.
+/// The dispatched versions pick AVX2, SSE2 or scalar code on first
+/// call, according to the running CPU.
+
+typedef const char* (*FindCRLFFunc)(const char* begin, const char* end);
+typedef const char* (*FindByteFunc)(const char* begin, const char* end, char c);
+
+extern FindCRLFFunc g_findCRLF;
+extern FindByteFunc g_findByte;
+
+/// Finds the first "\r\n".
+inline const char* findCRLF(const char* begin, const char* end)
+{
+  return g_findCRLF(begin, end);
+}
+
+/// Finds the first @c c, e.g. '\n', ':' or ' '.
+inline const char* findByte(const char* begin, const char* end, char c)
+{
+  return g_findByte(begin, end, c);
+}
+
+// individual kernels, for tests and benchmarks.
+// the SIMD ones fall back to scalar if the CPU lacks support.
+const char* findCRLFScalar(const char* begin, const char* end);
+const char* findCRLFSse2(const char* begin, const char* end);
+const char* findCRLFAvx2(const char* begin, const char* end);
+const char* findByteScalar(const char* begin, const char* end, char c);
+const char* findByteSse2(const char* begin, const char* end, char c);
+const char* findByteAvx2(const char* begin, const char* end, char c);
+
+/// "avx2", "sse2" or "scalar"
+const char* scanKernelName();
+
+}  // namespace detail
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BYTESCAN_H
@@ -13,6 +13,7 @@
 #ifndef MUDUO_NET_CALLBACKS_H
 #define MUDUO_NET_CALLBACKS_H
 
+#include "muduo/base/Task.h"
 #include "muduo/base/Timestamp.h"
 
 #include <functional>
@@ -65,7 +66,7 @@ class Buffer;
 class TcpConnection;
 // 重命名 所有客户端可见的灰调函数
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;      // tcp 连接 智能指针
-typedef std::function<void()> TimerCallback;                  // 时间器 回调函数
+typedef Task TimerCallback;                                   // 时间器 回调函数，只能移动
 typedef std::function<void (const TcpConnectionPtr&)> ConnectionCallback; // tcp 连接回调函数
 typedef std::function<void (const TcpConnectionPtr&)> CloseCallback;      // tcp 关闭回调函数
 typedef std::function<void (const TcpConnectionPtr&)> WriteCompleteCallback;  // tcp 写入完成回调函数
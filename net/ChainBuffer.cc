@@ -0,0 +1,333 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/ChainBuffer.h"
+
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t ChainBuffer::kSlabSize;
+const int ChainBuffer::kMaxIovecs;
+const size_t ChainBuffer::kMinSharedBytes;
+const size_t ChainBuffer::kDefaultZeroCopyThreshold;
+
+ChainBuffer::ChainBuffer()
+  : readable_(0),
+    pool_(NULL),
+    zeroCopyThreshold_(0),
+    zeroCopySeq_(0)
+{
+}
+
+// slabs left here go back to pool_, so a pooled ChainBuffer which still
+// holds data is destructed in the loop thread, or detached with setPool(NULL).
+ChainBuffer::~ChainBuffer()
+{
+  for (Slab& slab : slabs_)
+  {
+    releaseSlab(&slab);
+  }
+}
+
+void ChainBuffer::setPool(BufferPool* pool)
+{
+  if (pool == pool_)
+  {
+    return;
+  }
+  for (const Slab& slab : slabs_)
+  {
+    if (!slab.payload && !slab.isFile())
+    {
+      if (pool_)
+      {
+        pool_->disown(slab.storage.size());
+      }
+      if (pool)
+      {
+        pool->adopt(slab.storage.size());
+      }
+    }
+  }
+  pool_ = pool;
+  if (pool_)
+  {
+    std::vector<char>().swap(spare_);
+  }
+}
+
+void ChainBuffer::allocSlab(std::vector<char>* storage)
+{
+  if (pool_)
+  {
+    *storage = pool_->acquire(kSlabSize);
+  }
+  else if (!spare_.empty())
+  {
+    storage->swap(spare_);
+  }
+  else
+  {
+    storage->resize(kSlabSize);
+  }
+}
+
+void ChainBuffer::freeSlab(std::vector<char>* storage)
+{
+  if (pool_)
+  {
+    pool_->release(storage);
+  }
+  else if (spare_.empty())
+  {
+    spare_.swap(*storage);
+  }
+}
+
+void ChainBuffer::releaseSlab(Slab* slab)
+{
+  if (slab->isFile())
+  {
+    ::close(slab->fileFd);
+    slab->fileFd = -1;
+  }
+  else if (!slab->payload)
+  {
+    freeSlab(&slab->storage);
+  }
+}
+
+// 只在尾部 slab 写满时才分配新的 slab，已有数据从不移动
+void ChainBuffer::append(const char* /*restrict*/ data, size_t len)
+{
+  readable_ += len;
+  while (len > 0)
+  {
+    if (slabs_.empty() || slabs_.back().writableBytes() == 0)
+    {
+      slabs_.push_back(Slab());
+      Slab& slab = slabs_.back();
+      allocSlab(&slab.storage);
+      slab.readIndex = 0;
+      slab.writeIndex = 0;
+    }
+    Slab& back = slabs_.back();
+    size_t n = std::min(len, back.writableBytes());
+    ::memcpy(back.storage.data() + back.writeIndex, data, n);
+    back.writeIndex += n;
+    data += n;
+    len -= n;
+  }
+}
+
+// 只增加引用计数，不拷贝数据
+void ChainBuffer::append(const SharedPayload& payload, size_t offset)
+{
+  assert(payload && offset <= payload->size());
+  const size_t len = payload->size() - offset;
+  if (len < kMinSharedBytes)
+  {
+    append(payload->data() + offset, len);
+    return;
+  }
+  readable_ += len;
+  slabs_.push_back(Slab());
+  Slab& slab = slabs_.back();
+  slab.payload = payload;
+  slab.readIndex = offset;
+  slab.writeIndex = payload->size();
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t len)
+{
+  assert(fd >= 0 && offset >= 0);
+  if (len == 0)
+  {
+    ::close(fd);
+    return;
+  }
+  readable_ += len;
+  slabs_.push_back(Slab());
+  Slab& slab = slabs_.back();
+  slab.fileFd = fd;
+  slab.readIndex = static_cast<size_t>(offset);
+  slab.writeIndex = static_cast<size_t>(offset) + len;
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+  assert(len <= readable_);
+  readable_ -= len;
+  while (len > 0)
+  {
+    assert(!slabs_.empty());
+    Slab& front = slabs_.front();
+    size_t n = std::min(len, front.readableBytes());
+    front.readIndex += n;
+    len -= n;
+    if (front.readableBytes() == 0)
+    {
+      releaseSlab(&front);
+      slabs_.pop_front();
+    }
+  }
+}
+
+void ChainBuffer::retrieveAll()
+{
+  retrieve(readable_);
+  assert(slabs_.empty());
+}
+
+string ChainBuffer::retrieveAllAsString()
+{
+  string result;
+  result.reserve(readable_);
+  for (const Slab& slab : slabs_)
+  {
+    if (slab.isFile())
+    {
+      // slow, only for tests and debugging
+      size_t offset = slab.readIndex;
+      char buf[4096];
+      while (offset < slab.writeIndex)
+      {
+        ssize_t n = ::pread(slab.fileFd, buf, std::min(sizeof buf, slab.writeIndex - offset),
+                            static_cast<off_t>(offset));
+        if (n <= 0)
+        {
+          break;
+        }
+        result.append(buf, n);
+        offset += n;
+      }
+    }
+    else
+    {
+      result.append(slab.data() + slab.readIndex, slab.readableBytes());
+    }
+  }
+  retrieveAll();
+  return result;
+}
+
+int ChainBuffer::peekIovec(struct iovec* vec, int maxvec) const
+{
+  int n = 0;
+  for (std::deque<Slab>::const_iterator it = slabs_.begin();
+       it != slabs_.end() && n < maxvec && !it->isFile(); ++it)
+  {
+    vec[n].iov_base = const_cast<char*>(it->data()) + it->readIndex;
+    vec[n].iov_len = it->readableBytes();
+    ++n;
+  }
+  return n;
+}
+
+// 文件数据不经过用户空间，由内核直接从 page cache 发送
+ssize_t ChainBuffer::writeFile(int fd, int* savedErrno)
+{
+  Slab& front = slabs_.front();
+  off_t offset = static_cast<off_t>(front.readIndex);
+  const ssize_t n = sockets::sendfile(fd, front.fileFd, &offset, front.readableBytes());
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else if (n == 0)
+  {
+    // file was truncated after it was queued
+    *savedErrno = ENODATA;
+    return -1;
+  }
+  else
+  {
+    retrieve(implicit_cast<size_t>(n));
+  }
+  return n;
+}
+
+// 内核在 send 返回后才读取数据，完成通知到达之前一直持有 payload 的引用
+ssize_t ChainBuffer::writeZeroCopy(int fd, int* savedErrno)
+{
+  SharedPayload payload = slabs_.front().payload;
+  const Slab& front = slabs_.front();
+  const ssize_t n = sockets::sendZeroCopy(fd, front.data() + front.readIndex,
+                                          front.readableBytes());
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    pinned_.push_back(std::make_pair(zeroCopySeq_++, payload));
+    retrieve(implicit_cast<size_t>(n));
+  }
+  return n;
+}
+
+void ChainBuffer::onZeroCopyComplete(uint32_t lo, uint32_t hi)
+{
+  // usually in order, so this pops from the front
+  std::deque<std::pair<uint32_t, SharedPayload> >::iterator it = pinned_.begin();
+  while (it != pinned_.end())
+  {
+    // wrap-around safe lo <= seq <= hi
+    if (it->first - lo <= hi - lo)
+    {
+      it = pinned_.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno)
+{
+  if (!slabs_.empty() && slabs_.front().isFile())
+  {
+    return writeFile(fd, savedErrno);
+  }
+  if (zeroCopyThreshold_ > 0
+      && !slabs_.empty()
+      && slabs_.front().payload
+      && slabs_.front().readableBytes() >= zeroCopyThreshold_)
+  {
+    ssize_t n = writeZeroCopy(fd, savedErrno);
+    // ENOBUFS: over the optmem limit for pinned pages, copy this time
+    if (n >= 0 || *savedErrno != ENOBUFS)
+    {
+      return n;
+    }
+  }
+  struct iovec vec[kMaxIovecs];
+  const int iovcnt = peekIovec(vec, kMaxIovecs);
+  const ssize_t n = sockets::writev(fd, vec, iovcnt);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    retrieve(implicit_cast<size_t>(n));
+  }
+  return n;
+}
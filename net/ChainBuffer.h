@@ -0,0 +1,184 @@
+// check 链式输出缓冲区，由固定大小的 slab 组成，用 writev 一次写出多个 slab
+
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_CHAINBUFFER_H
+#define MUDUO_NET_CHAINBUFFER_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+#include <sys/types.h>  // ssize_t
+
+struct iovec;
+
+namespace muduo
+{
+namespace net
+{
+
+class BufferPool;
+
+/// Immutable, reference counted message body.
+/// The same payload can be queued by many connections without copying,
+/// e.g. one message fanned out to all subscribers of a topic.
+typedef std::shared_ptr<const string> SharedPayload;
+
+///
+/// A chain of fixed-size slabs, used as output buffer of TcpConnection.
+///
+/// Unlike Buffer, appending never moves data that is already queued,
+/// so a large backlog costs O(appended bytes) instead of O(backlog).
+/// Readable data is drained with writev(2).
+///
+/// A SharedPayload can be queued by reference, it becomes a segment of
+/// its own which points into the payload and holds a reference to it.
+/// A file region can be queued too, it is sent with sendfile(2) when it
+/// reaches the front.
+///
+/// With a zero-copy threshold set, large payload segments are sent with
+/// MSG_ZEROCOPY.  The kernel then reads the payload after send(2) returns,
+/// so the buffer keeps ("pins") a reference until the completion for that
+/// send is reported with onZeroCopyComplete().  The owner must keep the
+/// buffer, and the socket, until numPinned() drops to 0.
+///
+/// @code
+/// +------+---------+   +----------------+   +---------+---------+
+/// | sent | CONTENT |-->|    CONTENT     |-->| CONTENT |writable |
+/// +------+---------+   +----------------+   +---------+---------+
+///   front slab                                  back slab
+/// @endcode
+class ChainBuffer : noncopyable
+{
+ public:
+  static const size_t kSlabSize = 16*1024;
+  static const int kMaxIovecs = 64;   // at most 1MiB per writev
+  // payloads shorter than this are copied, a reference costs an iovec
+  static const size_t kMinSharedBytes = 1024;
+  // below ~10KiB page pinning costs more than copying
+  static const size_t kDefaultZeroCopyThreshold = 16*1024;
+
+  ChainBuffer();
+  ~ChainBuffer();
+
+  /// Takes slabs from @c pool and gives drained ones back.
+  /// Slabs holding data are accounted to @c pool instead of the current one.
+  /// Must be called in the loop thread which owns @c pool,
+  /// and the one which owns the current pool.
+  void setPool(BufferPool* pool);
+
+  // 可读的长度
+  size_t readableBytes() const
+  { return readable_; }
+
+  size_t numSlabs() const
+  { return slabs_.size(); }
+
+  /// Payload segments of at least @c threshold bytes are sent with
+  /// MSG_ZEROCOPY, 0 disables it.  The socket must have SO_ZEROCOPY on.
+  void setZeroCopyThreshold(size_t threshold)
+  { zeroCopyThreshold_ = threshold; }
+
+  size_t zeroCopyThreshold() const
+  { return zeroCopyThreshold_; }
+
+  /// Number of zero-copy sends the kernel has not completed yet.
+  size_t numPinned() const
+  { return pinned_.size(); }
+
+  /// Unpins payloads of zero-copy sends numbered [lo, hi].
+  void onZeroCopyComplete(uint32_t lo, uint32_t hi);
+
+  void append(const StringPiece& str)
+  {
+    append(str.data(), str.size());
+  }
+
+  void append(const void* /*restrict*/ data, size_t len)
+  {
+    append(static_cast<const char*>(data), len);
+  }
+
+  void append(const char* /*restrict*/ data, size_t len);
+
+  /// Queues payload[offset, size()) without copying it,
+  /// unless it is shorter than kMinSharedBytes.
+  void append(const SharedPayload& payload, size_t offset = 0);
+
+  /// Queues [offset, offset+len) of file @c fd, takes ownership of @c fd,
+  /// which is closed once the region is retrieved.
+  void appendFile(int fd, off_t offset, size_t len);
+
+  void retrieve(size_t len);
+
+  void retrieveAll();
+
+  string retrieveAllAsString();
+
+  /// Fills at most @c maxvec iovecs with readable data, front first.
+  /// Stops at the first file region.
+  /// @return number of iovecs filled.
+  int peekIovec(struct iovec* vec, int maxvec) const;
+
+  /// Writes readable data with writev(2), or sendfile(2) if a file region
+  /// is at the front, and retrieves what was written.
+  /// @return result of writev(2) or sendfile(2), @c errno is saved.
+  /// A file shorter than queued fails with ENODATA.
+  ssize_t writeFd(int fd, int* savedErrno);
+
+ private:
+  // either owns storage, or refers to a shared payload which is read-only,
+  // or is a file region whose indices are file offsets
+  struct Slab
+  {
+    std::vector<char> storage;
+    SharedPayload payload;
+    int fileFd = -1;
+    size_t readIndex;
+    size_t writeIndex;
+
+    bool isFile() const { return fileFd >= 0; }
+    const char* data() const
+    { return payload ? payload->data() : storage.data(); }
+    size_t readableBytes() const { return writeIndex - readIndex; }
+    size_t writableBytes() const
+    { return payload || isFile() ? 0 : storage.size() - writeIndex; }
+  };
+
+  void allocSlab(std::vector<char>* storage);
+  void freeSlab(std::vector<char>* storage);
+  void releaseSlab(Slab* slab);
+  ssize_t writeFile(int fd, int* savedErrno);
+  ssize_t writeZeroCopy(int fd, int* savedErrno);
+
+  std::deque<Slab> slabs_;
+  size_t readable_;
+  BufferPool* pool_;
+  // without a pool, keep one drained slab around, so a connection that
+  // keeps crossing a slab boundary does not allocate on every send.
+  std::vector<char> spare_;
+  size_t zeroCopyThreshold_;
+  // the kernel numbers successful MSG_ZEROCOPY sends on a socket from 0
+  uint32_t zeroCopySeq_;
+  std::deque<std::pair<uint32_t, SharedPayload> > pinned_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_CHAINBUFFER_H
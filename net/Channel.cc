@@ -29,6 +29,8 @@ Channel::Channel(EventLoop* loop, int fd__)
     revents_(0),
     index_(-1),
     logHup_(true),
+    edgeTriggered_(false),
+    deferredEvents_(0),
     tied_(false),
     eventHandling_(false),
     addedToLoop_(false)
@@ -60,6 +62,15 @@ void Channel::update()
   loop_->updateChannel(this);
 }
 
+void Channel::setEdgeTriggered(bool on)
+{
+  edgeTriggered_ = on;
+  if (addedToLoop_)
+  {
+    update();
+  }
+}
+
 // 调用 loop 删除 channel
 void Channel::remove()
 {
@@ -68,6 +79,13 @@ void Channel::remove()
   loop_->removeChannel(this);
 }
 
+void Channel::setOwnerLoop(EventLoop* loop)
+{
+  assert(!addedToLoop_);
+  assert(!eventHandling_);
+  loop_ = loop;
+}
+
 void Channel::handleEvent(Timestamp receiveTime)
 {
   // ?????????
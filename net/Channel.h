@@ -63,7 +63,7 @@ class Channel : noncopyable
   int fd() const { return fd_; }
   int events() const { return events_; }
   void set_revents(int revt) { revents_ = revt; } // used by pollers
-  // int revents() const { return revents_; }
+  int revents() const { return revents_; }
   // 判断当前channel 是否没事件发生
   bool isNoneEvent() const { return events_ == kNoneEvent; }
 
@@ -78,6 +78,18 @@ class Channel : noncopyable
   bool isWriting() const { return events_ & kWriteEvent; }
   bool isReading() const { return events_ & kReadEvent; }
 
+  /// 边沿触发，对 EPollPoller 和 IoUringPoller 有效
+  /// Edge-triggered with epoll, or a multishot poll with io_uring,
+  /// the owner must drain the fd until EAGAIN,
+  /// or call EventLoop::deferChannel() to go on in the next iteration.
+  /// PollPoller ignores it.
+  void setEdgeTriggered(bool on);
+  bool isEdgeTriggered() const { return edgeTriggered_; }
+
+  // for EventLoop::deferChannel()
+  int deferredEvents() const { return deferredEvents_; }
+  void set_deferredEvents(int ev) { deferredEvents_ = ev; }
+
   // for Poller 返回当前 channel 在 poller 中 容器的序号
   int index() { return index_; }
   void set_index(int idx) { index_ = idx; }
@@ -92,6 +104,10 @@ class Channel : noncopyable
   EventLoop* ownerLoop() { return loop_; }
   void remove();
 
+  /// Moves to another loop, e.g. TcpConnection::migrate().
+  /// Must be removed from the current one, the next update() adds it.
+  void setOwnerLoop(EventLoop* loop);
+
  private:
   static string eventsToString(int fd, int ev);
 
@@ -108,6 +124,8 @@ class Channel : noncopyable
   int        revents_; // it's the received event types of epoll or poll
   int        index_; // used by Poller.
   bool       logHup_;
+  bool       edgeTriggered_;
+  int        deferredEvents_;   // to handle again in the next iteration
 
   std::weak_ptr<void> tie_;     // 使用弱指针绑定 共享指针，可以从 tie 使用 lock
   bool tied_;
@@ -10,15 +10,18 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/base/Mutex.h"
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/Poller.h"
 #include "muduo/net/SocketsOps.h"
 #include "muduo/net/TimerQueue.h"
+#include "muduo/net/poller/IoUringPoller.h"
 
 #include <algorithm>
 
 #include <signal.h>
 #include <sys/eventfd.h>
+#include <time.h>
 #include <unistd.h>
 
 using namespace muduo;
@@ -59,7 +62,27 @@ class IgnoreSigPipe
 IgnoreSigPipe initObj;
 }  // namespace
 
+// 任务队列的节点
+struct EventLoop::PendingFunctor
+{
+  PendingFunctor()
+    : next(NULL)
+  {
+  }
+
+  Functor functor;
+  std::atomic<PendingFunctor*> next;   // owned by MpscQueue or MpscNodePool
+};
+
 // 获得当前线程的 eventloop
+// 测量短时间间隔，不受时钟模式和系统时间调整的影响
+int64_t EventLoop::monotonicMicroSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 EventLoop* EventLoop::getEventLoopOfCurrentThread()
 {
   // 线程变量的指针
@@ -68,16 +91,37 @@ EventLoop* EventLoop::getEventLoopOfCurrentThread()
 
 EventLoop::EventLoop()
   : looping_(false),
+    clockMode_(kPreciseClock),
+    timerMode_(kTimerfd),
+    timerWheelTick_(0),
     quit_(false),
     eventHandling_(false),
     callingPendingFunctors_(false),
+    callingPendingFlushes_(false),
     iteration_(0),
     threadId_(CurrentThread::tid()),  // 获得当前的线程id
+    pollReturnTime_(Timestamp::now()),
+    bufferPool_(new BufferPool),          // 缓冲区内存池
     poller_(Poller::newDefaultPoller(this)),  // 创建一个 poll 内核
+    ioUringPoller_(dynamic_cast<IoUringPoller*>(get_pointer(poller_))),
     timerQueue_(new TimerQueue(this)),    // 时间器队列
     wakeupFd_(createEventfd()),                           // 创建唤醒 fd
     wakeupChannel_(new Channel(this, wakeupFd_)),         // 唤醒 fd 上的 channel
-    currentActiveChannel_(NULL)                           // 当前激活的 channel
+    currentActiveChannel_(NULL),                          // 当前激活的 channel
+    deferredCount_(0),
+    channelByteBudget_(0),
+    channelTimeBudget_(0),
+    busyPollSpin_(0),
+    socketBusyPoll_(0),
+    busyPollSpins_(0),
+    busyPollHits_(0),
+    busyPollMisses_(0),
+    numConnections_(0),
+    busyMicroSeconds_(0),
+    busyAccounting_(false),
+    polling_(false),
+    wakeupPending_(false),
+    wakeupCount_(0)
 {
   LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
   // 构造函数创建 EventLoop 时，t_loopInThisThread 不能被赋值
@@ -107,6 +151,14 @@ EventLoop::~EventLoop()
   wakeupChannel_->disableAll();
   wakeupChannel_->remove();
   ::close(wakeupFd_);
+  // functors queued but never run, no producer is left
+  PendingFunctor* node = pendingFunctors_.popAll();
+  while (node)
+  {
+    PendingFunctor* next = node->next.load(std::memory_order_relaxed);
+    delete node;
+    node = next;
+  }
   t_loopInThisThread = NULL;      // 重置当前线程的 EventLoop
 }
 
@@ -119,14 +171,46 @@ void EventLoop::loop()
   looping_ = true;
   quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
   LOG_TRACE << "EventLoop " << this << " start looping";
+  if (clockMode_ != kPreciseClock)
+  {
+    Logger::setThreadClock(&pollReturnTime_);
+  }
 
   while (!quit_)
   {
     activeChannels_.clear();
     
     // io复用
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    // deferred channels have work left, don't block
+    int timeoutMs = deferredChannels_.empty() ? kPollTimeMs : 0;
+    if (timeoutMs > 0 && timerMode_ == kPollTimeout)
+    {
+      // 最早的时间器决定 poll 的超时
+      timeoutMs = timerQueue_->pollTimeout(timeoutMs);
+    }
+    // 忙轮询找到事件就不再阻塞
+    const bool spun = timeoutMs > 0 && busyPollSpin_ > 0 && spinPoll();
+    if (!spun)
+    {
+      if (timeoutMs > 0)
+      {
+        // from now on queueInLoop() wakes us up, what it queued before
+        // is seen here.  Both sides are seq_cst, one of them sees the other.
+        wakeupPending_.store(false);
+        polling_.store(true);
+        if (!pendingFunctors_.empty())
+        {
+          timeoutMs = 0;
+        }
+      }
+      pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+      polling_.store(false);
+    }
     ++iteration_;
+    // 本轮处理的起点，与时钟模式无关
+    const int64_t busyStart =
+        busyAccounting_.load(std::memory_order_relaxed) ? monotonicMicroSeconds() : 0;
+    addDeferredChannels();
     if (Logger::logLevel() <= Logger::TRACE)
     {
       printActiveChannels();
@@ -141,9 +225,23 @@ void EventLoop::loop()
     }
     currentActiveChannel_ = NULL;
     eventHandling_ = false;
+    if (timerMode_ == kPollTimeout)
+    {
+      timerQueue_->runExpiredTimers();
+    }
     doPendingFunctors();
+    doPendingFlushes();
+
+    // 本轮处理用时
+    if (busyStart > 0)
+    {
+      int64_t busy = monotonicMicroSeconds() - busyStart;
+      busyMicroSeconds_.store(busyMicroSeconds_.load(std::memory_order_relaxed) + busy,
+                              std::memory_order_relaxed);
+    }
   }
 
+  Logger::setThreadClock(NULL);
   LOG_TRACE << "EventLoop " << this << " stop looping";
   looping_ = false;
 }
@@ -176,12 +274,39 @@ void EventLoop::runInLoop(Functor cb)
 
 void EventLoop::queueInLoop(Functor cb)
 {
+  // 节点来自回收池，通常不分配内存
+  PendingFunctor* node = functorPool_.get();
+  if (node == NULL)
+  {
+    node = new PendingFunctor;
+  }
+  node->functor = std::move(cb);
+  pendingFunctors_.push(node);
+  // the loop checks the queue before it blocks, including when cb is
+  // queued by a pending functor in the loop thread
+  wakeupIfPolling();
+}
+
+void EventLoop::wakeupIfPolling()
+{
+  if (polling_.load() && !wakeupPending_.exchange(true))
+  {
+    wakeup();
+  }
+}
+
+void EventLoop::queueFlush(Functor cb)
+{
+  bool first = false;
   {
   MutexLockGuard lock(mutex_);
-  pendingFunctors_.push_back(std::move(cb));
+  first = pendingFlushes_.empty();
+  pendingFlushes_.push_back(std::move(cb));
   }
 
-  if (!isInLoopThread() || callingPendingFunctors_)
+  // 只在队列由空变为非空时唤醒，之后的 flush 由同一次唤醒处理
+  // flushes queued while flushing run in the next iteration, don't block in poll
+  if (first && (!isInLoopThread() || callingPendingFlushes_))
   {
     wakeup();
   }
@@ -190,7 +315,6 @@ void EventLoop::queueInLoop(Functor cb)
 // 获得pendingFunctors_队列的大小
 size_t EventLoop::queueSize() const
 {
-  MutexLockGuard lock(mutex_);
   return pendingFunctors_.size();
 }
 
@@ -200,23 +324,74 @@ TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 }
 
 // 延迟delay时间后运行函数 
+// 缓存时钟模式下，loop 线程里从本轮循环的时间开始计算
+Timestamp EventLoop::timerBase() const
+{
+  if (clockMode_ != kPreciseClock && isInLoopThread())
+  {
+    return now();
+  }
+  return readClock();
+}
+
 TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), delay));
+  Timestamp time(addTime(timerBase(), delay));
   return runAt(time, std::move(cb));
 }
 
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), interval));
+  Timestamp time(addTime(timerBase(), interval));
   return timerQueue_->addTimer(std::move(cb), time, interval);
 }
 
+TimerId EventLoop::runAfter(double delay, double slack, TimerCallback cb)
+{
+  Timestamp time(addTime(timerBase(), delay));
+  return timerQueue_->addTimer(std::move(cb), time, 0.0, slack);
+}
+
+TimerId EventLoop::runEvery(double interval, double slack, TimerCallback cb)
+{
+  Timestamp time(addTime(timerBase(), interval));
+  return timerQueue_->addTimer(std::move(cb), time, interval, slack);
+}
+
 void EventLoop::cancel(TimerId timerId)
 {
   return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::setTimerMode(TimerMode mode)
+{
+  assertInLoopThread();
+  assert(!looping_);
+  // the old queue is destroyed with its timers, and adds from other
+  // threads still pending would run on it
+  assert(timerQueue_->numTimers() == 0);
+  if (mode != timerMode_)
+  {
+    // the old queue removes its timerfd channel
+    timerQueue_.reset();
+    timerQueue_.reset(new TimerQueue(this, mode == kTimerfd, timerWheelTick_));
+    timerMode_ = mode;
+  }
+}
+
+void EventLoop::setTimerWheel(int64_t tickMicroSeconds)
+{
+  assertInLoopThread();
+  assert(!looping_);
+  assert(timerQueue_->numTimers() == 0);
+  if (tickMicroSeconds != timerWheelTick_)
+  {
+    timerQueue_.reset();
+    timerQueue_.reset(new TimerQueue(this, timerMode_ == kTimerfd, tickMicroSeconds));
+    timerWheelTick_ = tickMicroSeconds;
+  }
+}
+
 // 更新 channel
 void EventLoop::updateChannel(Channel* channel)
 {
@@ -234,9 +409,83 @@ void EventLoop::removeChannel(Channel* channel)
     assert(currentActiveChannel_ == channel ||
         std::find(activeChannels_.begin(), activeChannels_.end(), channel) == activeChannels_.end());
   }
+  if (channel->deferredEvents())
+  {
+    channel->set_deferredEvents(0);
+    deferredChannels_.erase(
+        std::remove(deferredChannels_.begin(), deferredChannels_.end(), channel),
+        deferredChannels_.end());
+  }
   poller_->removeChannel(channel);
 }
 
+void EventLoop::deferChannel(Channel* channel, int revents)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  if (revents == 0)
+  {
+    return;
+  }
+  if (channel->deferredEvents() == 0)
+  {
+    deferredChannels_.push_back(channel);
+  }
+  channel->set_deferredEvents(channel->deferredEvents() | revents);
+  ++deferredCount_;
+}
+
+// 上一轮被推迟的 channel 加入本轮的活动列表
+void EventLoop::addDeferredChannels()
+{
+  if (deferredChannels_.empty())
+  {
+    return;
+  }
+  // polled again, merge the deferred events
+  for (Channel* channel : activeChannels_)
+  {
+    if (channel->deferredEvents())
+    {
+      channel->set_revents(channel->revents() | channel->deferredEvents());
+      channel->set_deferredEvents(0);
+    }
+  }
+  for (Channel* channel : deferredChannels_)
+  {
+    // the owner may have lost interest since, e.g. stopped reading
+    const int revents = channel->deferredEvents() & channel->events();
+    channel->set_deferredEvents(0);
+    if (revents)
+    {
+      channel->set_revents(revents);
+      activeChannels_.push_back(channel);
+    }
+  }
+  deferredChannels_.clear();
+}
+
+// 在阻塞之前用 0 超时反复轮询，没有唤醒的系统调用
+// queueInLoop() doesn't write the eventfd meanwhile, functors are seen here
+// @return true if it found events or pending functors
+bool EventLoop::spinPoll()
+{
+  // the window is far shorter than a tick of the coarse clock
+  const int64_t deadline = monotonicMicroSeconds() + busyPollSpin_;
+  do
+  {
+    ++busyPollSpins_;
+    pollReturnTime_ = poller_->poll(0, &activeChannels_);
+    if (!activeChannels_.empty() || !pendingFunctors_.empty())
+    {
+      ++busyPollHits_;
+      return true;
+    }
+  } while (monotonicMicroSeconds() < deadline);
+  ++busyPollMisses_;
+  return false;
+}
+
 bool EventLoop::hasChannel(Channel* channel)
 {
   assert(channel->ownerLoop() == this);
@@ -255,6 +504,7 @@ void EventLoop::abortNotInLoopThread()
 // 向 wakeup fd 写入一个数字，表示唤醒
 void EventLoop::wakeup()
 {
+  wakeupCount_.fetch_add(1, std::memory_order_relaxed);
   uint64_t one = 1;
   ssize_t n = sockets::write(wakeupFd_, &one, sizeof one);
   if (n != sizeof one)
@@ -277,21 +527,42 @@ void EventLoop::handleRead()
 // 处理挂起的 函数体
 void EventLoop::doPendingFunctors()
 {
-  std::vector<Functor> functors;
   callingPendingFunctors_ = true;
 
-  // 置换 pendingFunctors_ ==> functors
+  // 一次取出所有 pendingFunctors_，按入队顺序执行
+  // functors queued meanwhile run in the next iteration
+  PendingFunctor* node = pendingFunctors_.popAll();
+  while (node)
+  {
+    // 执行函数任务
+    node->functor();
+    PendingFunctor* next = node->next.load(std::memory_order_relaxed);
+    // release what the functor holds now, not when the node is reused
+    node->functor = nullptr;
+    if (!functorPool_.put(node))
+    {
+      delete node;
+    }
+    node = next;
+  }
+  callingPendingFunctors_ = false;
+}
+
+void EventLoop::doPendingFlushes()
+{
+  std::vector<Functor> flushes;
+  callingPendingFlushes_ = true;
+
   {
     MutexLockGuard lock(mutex_);
-    functors.swap(pendingFunctors_);
+    flushes.swap(pendingFlushes_);
   }
 
-  for (const Functor& functor : functors)
+  for (const Functor& flush : flushes)
   {
-    // 执行函数任务
-    functor();
+    flush();
   }
-  callingPendingFunctors_ = false;
+  callingPendingFlushes_ = false;
 }
 
 // 打印所有激活的channels
@@ -21,6 +21,7 @@
 #include <boost/any.hpp>
 
 #include "muduo/base/Mutex.h"
+#include "muduo/base/MpscQueue.h"
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
@@ -31,7 +32,9 @@ namespace muduo
 namespace net
 {
 
+class BufferPool;
 class Channel;
+class IoUringPoller;
 class Poller;
 class TimerQueue;       // 时间器队列
 
@@ -42,7 +45,23 @@ class TimerQueue;       // 时间器队列
 class EventLoop : noncopyable
 {
  public:
-  typedef std::function<void()> Functor;
+  // move-only, bound arguments up to Task::kInlineSize bytes don't allocate
+  typedef Task Functor;
+
+  /// 时钟模式
+  enum ClockMode
+  {
+    kPreciseClock,  // 默认，每次都读 gettimeofday
+    kCachedClock,   // 每轮循环读一次时钟，定时器和日志使用 now()
+    kCoarseClock,   // 同上，从 CLOCK_REALTIME_COARSE 读取
+  };
+
+  /// 时间器模式
+  enum TimerMode
+  {
+    kTimerfd,       // 默认，由 timerfd 通知到期
+    kPollTimeout,   // 由最早的到期时间计算 poll 超时，没有 timerfd
+  };
 
   EventLoop();
   ~EventLoop();  // force out-line dtor, for std::unique_ptr members.
@@ -65,6 +84,30 @@ class EventLoop : noncopyable
   ///
   Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+  ///
+  /// Cached clock of the loop: the time of the current iteration, read
+  /// once when poll returns.  Handlers that only need it to within the
+  /// iteration can use it instead of Timestamp::now().
+  /// Must be called in the loop thread.
+  ///
+  Timestamp now() const { return pollReturnTime_; }
+
+  /// Reads the clock of this loop, precise or coarse.
+  Timestamp readClock() const
+  { return clockMode_ == kCoarseClock ? Timestamp::nowCoarse() : Timestamp::now(); }
+
+  /// CLOCK_MONOTONIC in microseconds, whatever the clock mode, for
+  /// measuring short intervals such as budgets and busy time.
+  static int64_t monotonicMicroSeconds();
+
+  /// kCachedClock and kCoarseClock: runAfter() and runEvery() in the loop
+  /// thread count from now(), expired timers are found with now(), and log
+  /// lines of the loop thread carry now().  kCoarseClock also makes poll
+  /// read CLOCK_REALTIME_COARSE, which is good to a few milliseconds.
+  /// Not thread safe, call before loop().
+  void setClockMode(ClockMode mode) { clockMode_ = mode; }
+  ClockMode clockMode() const { return clockMode_; }
+
   int64_t iteration() const { return iteration_; }
 
   /// Runs callback immediately in the loop thread.
@@ -77,12 +120,24 @@ class EventLoop : noncopyable
   /// Queues callback in the loop thread.
   /// Runs after finish pooling.
   /// Safe to call from other threads.
-  /// 将回调函数存入任务队列中，线程安全
+  /// Lock free, wakes up the loop only if it is blocked, or about to
+  /// block, in poll, and only once for many callers.
+  /// 将回调函数存入任务队列中，线程安全，无锁
   void queueInLoop(Functor cb);
 
   /// 返回任务队列长度
   size_t queueSize() const;
 
+  /// Number of wakeup() calls, for monitoring.
+  int64_t wakeupCount() const { return wakeupCount_.load(std::memory_order_relaxed); }
+
+  /// Queues a flush, run once in the next loop iteration
+  /// after pending functors, e.g. to write output that several
+  /// threads coalesced into one connection.
+  /// Safe to call from other threads.
+  /// 每轮循环在任务队列之后执行一次，用于合并多个线程的写操作
+  void queueFlush(Functor cb);
+
   // timers
 
   ///
@@ -101,17 +156,116 @@ class EventLoop : noncopyable
   /// 每过interval时间后调用回调函数
   TimerId runEvery(double interval, TimerCallback cb);
   ///
+  /// 允许延迟 slack 秒，相近的时间器合并到同一次唤醒
+  /// Like runAfter() and runEvery(), but each run may be up to @c slack
+  /// seconds late.  Timers with slack expire on shared boundaries, so that
+  /// idle kicks, stats flushes and retries of many connections take one
+  /// wakeup together.
+  /// Safe to call from other threads.
+  TimerId runAfter(double delay, double slack, TimerCallback cb);
+  TimerId runEvery(double interval, double slack, TimerCallback cb);
+  ///
   /// Cancels the timer.
   /// Safe to call from other threads.
   /// 取消时间器的回调函数
   void cancel(TimerId timerId);
 
+  ///
+  /// kPollTimeout: no timerfd and no timerfd_settime(2) when the earliest
+  /// timer changes.  poll waits until the earliest expiration, and expired
+  /// timers run after the events of the iteration, with millisecond
+  /// resolution.
+  /// Not thread safe, call in the loop thread before loop().
+  /// Timers are not carried over, asserts that none has been added.
+  void setTimerMode(TimerMode mode);
+  TimerMode timerMode() const { return timerMode_; }
+
+  ///
+  /// 时间轮：大量时间器时 O(1) 添加和取消
+  /// Keeps timers in a hierarchical timing wheel with ticks of
+  /// @c tickMicroSeconds, timers run up to one tick late.
+  /// 0, the default, keeps them in a heap sorted by expiration.
+  /// Not thread safe, call in the loop thread before loop().
+  /// Timers are not carried over, asserts that none has been added.
+  void setTimerWheel(int64_t tickMicroSeconds);
+  int64_t timerWheelTick() const { return timerWheelTick_; }
+
+  ///
+  /// Storage pool shared by the buffers of connections in this loop.
+  /// Statistics are safe to read from other threads.
+  BufferPool* bufferPool() const { return get_pointer(bufferPool_); }
+
   // internal usage
+  /// NULL unless the poller is io_uring, see MUDUO_USE_IO_URING.
+  IoUringPoller* ioUringPoller() const { return ioUringPoller_; }
   void wakeup();
   void updateChannel(Channel* channel);
   void removeChannel(Channel* channel);
   bool hasChannel(Channel* channel);
 
+  /// Handles @c channel again in the next iteration with @c revents,
+  /// for an owner that stops draining it after using up a budget.
+  /// The next poll doesn't block while channels are deferred.
+  void deferChannel(Channel* channel, int revents);
+
+  /// Number of deferChannel() calls, for monitoring.
+  int64_t deferredCount() const { return deferredCount_; }
+
+  /// 公平性预算：每个连接每轮最多读 bytes 字节，回调最多运行 microSeconds 微秒
+  /// Fairness budget of each connection per iteration: an edge-triggered
+  /// one stops reading after @c bytes, or once its message callbacks took
+  /// @c microSeconds, and is deferred to the next iteration.
+  /// A level-triggered connection reads once per event either way; when
+  /// that read reached @c bytes or its callback took @c microSeconds, it is
+  /// deferred too, and counted by deferredCount().
+  /// 0 means no limit.
+  /// Not thread safe, call before loop().
+  void setChannelBudget(size_t bytes, int64_t microSeconds)
+  { channelByteBudget_ = bytes; channelTimeBudget_ = microSeconds; }
+  size_t channelByteBudget() const { return channelByteBudget_; }
+  int64_t channelTimeBudget() const { return channelTimeBudget_; }
+  bool hasChannelBudget() const
+  { return channelByteBudget_ > 0 || channelTimeBudget_ > 0; }
+
+  /// 忙轮询：阻塞之前先用 0 超时轮询 spinMicroSeconds 微秒，用一个核换延迟
+  /// Busy-poll mode: each time the loop runs out of work, it polls with
+  /// a zero timeout for up to @c spinMicroSeconds before it blocks in poll.
+  /// The window starts over after any work, so a busy loop never sleeps and
+  /// an idle one blocks after a single window.
+  /// If @c socketMicroSeconds > 0, connections of this loop also get
+  /// SO_BUSY_POLL, see Socket::setBusyPoll().
+  /// 0 turns it off.  Not thread safe, call before loop().
+  void setBusyPoll(int64_t spinMicroSeconds, int socketMicroSeconds = 0)
+  { busyPollSpin_ = spinMicroSeconds; socketBusyPoll_ = socketMicroSeconds; }
+  int64_t busyPollSpin() const { return busyPollSpin_; }
+  int socketBusyPoll() const { return socketBusyPoll_; }
+
+  /// Busy-poll statistics, for monitoring: zero-timeout polls,
+  /// spin windows which found work (hits), and those which ran out and
+  /// fell back to a blocking poll (misses).
+  int64_t busyPollSpins() const { return busyPollSpins_; }
+  int64_t busyPollHits() const { return busyPollHits_; }
+  int64_t busyPollMisses() const { return busyPollMisses_; }
+
+  /// 负载统计，供 EventLoopThreadPool 选择 loop，可在其他线程读取
+  /// TcpConnections of this loop, from their construction to
+  /// connectDestroyed().
+  int numConnections() const
+  { return numConnections_.load(std::memory_order_relaxed); }
+  /// Microseconds spent out of poll, in events, timers and functors,
+  /// while busy accounting is on.  Sample it twice for a recent busy ratio.
+  int64_t busyMicroSeconds() const
+  { return busyMicroSeconds_.load(std::memory_order_relaxed); }
+  /// 默认关闭，开启后每轮循环多读两次单调时钟
+  /// Off by default.  EventLoopThreadPool turns it on for kLeastBusy and
+  /// rebalancing.  Safe to call from other threads.
+  void setBusyAccounting(bool on)
+  { busyAccounting_.store(on, std::memory_order_relaxed); }
+
+  // internal usage, by TcpConnection
+  void countConnection(int delta)
+  { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
+
   // pid_t threadId() const { return threadId_; }
   void assertInLoopThread()
   {
@@ -141,19 +295,33 @@ class EventLoop : noncopyable
   void abortNotInLoopThread();      // 退出程序
   void handleRead();  // waked up
   void doPendingFunctors();
+  void doPendingFlushes();
+  void addDeferredChannels();
+  void wakeupIfPolling();
+  bool spinPoll();
+  Timestamp timerBase() const;
 
   void printActiveChannels() const; // DEBUG
 
+  struct PendingFunctor;
+
   typedef std::vector<Channel*> ChannelList;      // 用于存储channel
 
   bool looping_; /* atomic */
+  ClockMode clockMode_;
+  TimerMode timerMode_;
+  int64_t timerWheelTick_;                      // 0 if no timing wheel
   std::atomic<bool> quit_;                      // 判断是否离开loop
   bool eventHandling_; /* atomic */
   bool callingPendingFunctors_; /* atomic */
+  bool callingPendingFlushes_; /* atomic */
   int64_t iteration_;                           // 记录 loop 循环的次数
   const pid_t threadId_;
   Timestamp pollReturnTime_;                    // poll返回时间戳
+  // outlives poller_, whose pending io_uring operations may own connections
+  std::unique_ptr<BufferPool> bufferPool_;      // 连接缓冲区的内存池
   std::unique_ptr<Poller> poller_;              // io复用机制
+  IoUringPoller* ioUringPoller_;                // poller_ if it is io_uring
   std::unique_ptr<TimerQueue> timerQueue_;      // 时间队列
   int wakeupFd_;                                // 唤醒fd，使用 eventfd() 创建
   // unlike in TimerQueue, which is an internal class,
@@ -164,9 +332,29 @@ class EventLoop : noncopyable
   // scratch variables
   ChannelList activeChannels_;                  // 激活的 channel 链表
   Channel* currentActiveChannel_;               // 当前的活动 channel
-
-  mutable MutexLock mutex_;
-  std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);   // 挂起的 函数体
+  ChannelList deferredChannels_;                // 下一轮继续处理的 channel
+  int64_t deferredCount_;
+  size_t channelByteBudget_;
+  int64_t channelTimeBudget_;                   // in microseconds
+  int64_t busyPollSpin_;                        // in microseconds
+  int socketBusyPoll_;                          // SO_BUSY_POLL
+  int64_t busyPollSpins_;
+  int64_t busyPollHits_;
+  int64_t busyPollMisses_;
+  std::atomic<int> numConnections_;
+  std::atomic<int64_t> busyMicroSeconds_;       // written by the loop only
+  std::atomic<bool> busyAccounting_;
+
+  MpscNodePool<PendingFunctor> functorPool_;    // 回收的任务节点
+  MpscQueue<PendingFunctor> pendingFunctors_;   // 挂起的 函数体
+  // the loop is blocked, or about to block, in poll and needs a wakeup
+  std::atomic<bool> polling_;
+  // a wakeup is on its way during this poll, the others may skip theirs
+  std::atomic<bool> wakeupPending_;
+  std::atomic<int64_t> wakeupCount_;
+
+  MutexLock mutex_;
+  std::vector<Functor> pendingFlushes_ GUARDED_BY(mutex_);    // 挂起的 flush
 };
 
 }  // namespace net
@@ -11,22 +11,40 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThread.h"
 
+#include <algorithm>
+
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+// kLeastBusy 和连接迁移的采样周期
+const double kSampleInterval = 0.1;
+// busy for this many samples in a row (1 second) before connections move
+const int kRebalanceSamples = 10;
+
+}  // namespace
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg)
   : baseLoop_(baseLoop),
     name_(nameArg),
     started_(false),
     numThreads_(0),
-    next_(0)
+    next_(0),
+    placement_(kRoundRobin),
+    rebalanceThreshold_(0.0)
 {
 }
 
 EventLoopThreadPool::~EventLoopThreadPool()
 {
+  if (samples_.size() > 0)
+  {
+    baseLoop_->cancel(sampleTimer_);
+  }
   // Don't delete loop, it's stack variable
   // 不需要删除 loop，都是栈中的变量
 }
@@ -53,6 +71,21 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
     // 单线程
     cb(baseLoop_);
   }
+  if ((placement_ == kLeastBusy || rebalanceCallback_) && !loops_.empty())
+  {
+    samples_.resize(loops_.size());
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+      loops_[i]->setBusyAccounting(true);
+      samples_[i].busyMicroSeconds = loops_[i]->busyMicroSeconds();
+      samples_[i].busyRatio = 0.0;
+      samples_[i].assigned = 0.0;
+      samples_[i].overloaded = 0;
+    }
+    sampleTime_ = Timestamp::now();
+    sampleTimer_ = baseLoop_->runEvery(kSampleInterval, kSampleInterval / 10,
+        std::bind(&EventLoopThreadPool::sampleBusyRatios, this));
+  }
 }
 
 // next_ 没有被保护，会不会有问题
@@ -63,7 +96,17 @@ EventLoop* EventLoopThreadPool::getNextLoop()
   // 如果单线程，获得当前的主线程
   EventLoop* loop = baseLoop_;
 
-  if (!loops_.empty())
+  if (placementCallback_ && !loops_.empty())
+  {
+    loop = placementCallback_(loops_);
+  }
+  else if (placement_ != kRoundRobin && !loops_.empty())
+  {
+    size_t least = leastLoaded();
+    loop = loops_[least];
+    next_ = static_cast<int>((least + 1) % loops_.size());
+  }
+  else if (!loops_.empty())
   {
     // round-robin
     loop = loops_[next_];
@@ -76,6 +119,124 @@ EventLoop* EventLoopThreadPool::getNextLoop()
   return loop;
 }
 
+// 从 next_ 开始找负载最低的 loop，相同时轮询
+size_t EventLoopThreadPool::leastLoaded()
+{
+  const size_t n = loops_.size();
+  size_t least = 0;
+  double leastLoad = 0.0;
+  for (size_t k = 0; k < n; ++k)
+  {
+    size_t i = (next_ + k) % n;
+    double load = 0.0;
+    switch (placement_)
+    {
+      case kLeastConnections:
+        load = loops_[i]->numConnections();
+        break;
+      case kLeastQueued:
+        load = static_cast<double>(loops_[i]->queueSize());
+        break;
+      case kLeastBusy:
+        load = samples_[i].busyRatio + samples_[i].assigned;
+        break;
+      default:
+        break;
+    }
+    if (k == 0 || load < leastLoad)
+    {
+      least = i;
+      leastLoad = load;
+    }
+  }
+
+  if (placement_ == kLeastBusy)
+  {
+    // 到下次采样前，按每个连接的平均忙碌程度估算新连接的负载，
+    // otherwise a burst of connections all go to the same loop
+    samples_[least].assigned += std::max(loadPerConnection(), 1e-3);
+  }
+  return least;
+}
+
+double EventLoopThreadPool::loadPerConnection() const
+{
+  double busy = 0.0;
+  int connections = 0;
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    busy += samples_[i].busyRatio;
+    connections += loops_[i]->numConnections();
+  }
+  return connections > 0 ? busy / connections : 0.0;
+}
+
+// 两次采样之间的忙碌时间占比，与上次的结果平均
+void EventLoopThreadPool::sampleBusyRatios()
+{
+  baseLoop_->assertInLoopThread();
+  Timestamp now(Timestamp::now());
+  double elapsed = timeDifference(now, sampleTime_) * Timestamp::kMicroSecondsPerSecond;
+  if (elapsed <= 0)
+  {
+    return;
+  }
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    LoadSample& sample = samples_[i];
+    int64_t busy = loops_[i]->busyMicroSeconds();
+    double ratio = static_cast<double>(busy - sample.busyMicroSeconds) / elapsed;
+    sample.busyMicroSeconds = busy;
+    sample.busyRatio = (sample.busyRatio + std::min(ratio, 1.0)) / 2;
+    sample.assigned = 0.0;
+  }
+  sampleTime_ = now;
+  if (rebalanceCallback_)
+  {
+    rebalance();
+  }
+}
+
+// 忙碌程度持续超过阈值的 loop，把一部分连接迁移到最空闲的 loop
+void EventLoopThreadPool::rebalance()
+{
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    LoadSample& sample = samples_[i];
+    sample.overloaded = sample.busyRatio > rebalanceThreshold_ ? sample.overloaded + 1 : 0;
+    const int connections = loops_[i]->numConnections();
+    // moving a single hot connection only moves the hot spot
+    if (sample.overloaded < kRebalanceSamples || connections < 2)
+    {
+      continue;
+    }
+
+    size_t least = i;
+    double leastLoad = sample.busyRatio;
+    for (size_t j = 0; j < loops_.size(); ++j)
+    {
+      double load = samples_[j].busyRatio + samples_[j].assigned;
+      if (load < leastLoad)
+      {
+        least = j;
+        leastLoad = load;
+      }
+    }
+    if (least == i || leastLoad >= rebalanceThreshold_)
+    {
+      continue;
+    }
+
+    // 移走一半的差距，假设连接平均分担 loop 的负载
+    double gap = (sample.busyRatio - leastLoad) / 2;
+    int count = std::max(static_cast<int>(connections * gap / sample.busyRatio), 1);
+    // wait for the next samples to show the effect
+    sample.overloaded = 0;
+    samples_[least].assigned += gap;
+    rebalanceCallback_(loops_[i], loops_[least], count);
+  }
+}
+
 // 根据 哈希值确定 loop
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
@@ -14,7 +14,9 @@
 #define MUDUO_NET_EVENTLOOPTHREADPOOL_H
 
 #include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
 #include "muduo/base/Types.h"
+#include "muduo/net/TimerId.h"
 
 #include <functional>
 #include <memory>
@@ -33,6 +35,19 @@ class EventLoopThreadPool : noncopyable
 {
  public:
   typedef std::function<void(EventLoop*)> ThreadInitCallback;
+  /// Picks one of the loops for a new connection, in the base loop.
+  typedef std::function<EventLoop*(const std::vector<EventLoop*>&)> PlacementCallback;
+  /// Moves @c count connections from one loop to another, in the base loop.
+  typedef std::function<void(EventLoop* from, EventLoop* to, int count)> RebalanceCallback;
+
+  /// 新连接放到哪个 loop
+  enum Placement
+  {
+    kRoundRobin,        // 默认，轮询
+    kLeastConnections,  // EventLoop::numConnections() 最少
+    kLeastQueued,       // EventLoop::queueSize() 最短
+    kLeastBusy,         // 最近的 EventLoop::busyMicroSeconds() 占比最低
+  };
 
   EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
   ~EventLoopThreadPool();
@@ -40,8 +55,22 @@ class EventLoopThreadPool : noncopyable
   // 线程初始化函数
   void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
+  /// Not thread safe, call before start().
+  /// Ties go round-robin, so an idle pool is filled evenly.
+  void setPlacement(Placement placement) { placement_ = placement; }
+  Placement placement() const { return placement_; }
+  /// Overrides setPlacement().
+  void setPlacementCallback(const PlacementCallback& cb)
+  { placementCallback_ = cb; }
+
+  /// 连接迁移：某个 loop 的忙碌程度持续超过 busyThreshold 时，
+  /// calls @c cb to move part of its connections to the least busy loop.
+  /// Not thread safe, call before start().
+  void setRebalanceCallback(double busyThreshold, const RebalanceCallback& cb)
+  { rebalanceThreshold_ = busyThreshold; rebalanceCallback_ = cb; }
+
   // valid after calling start()
-  /// round-robin 轮询 获得下一个 loop
+  /// 按 placement 获得下一个 loop
   EventLoop* getNextLoop();
 
   /// with the same hash code, it will always return the same EventLoop
@@ -57,6 +86,19 @@ class EventLoopThreadPool : noncopyable
   { return name_; }
 
  private:
+  // 最近一次采样的忙碌程度
+  struct LoadSample
+  {
+    int64_t busyMicroSeconds;
+    double busyRatio;
+    double assigned;    // estimated load of connections placed since
+    int overloaded;     // consecutive samples above rebalanceThreshold_
+  };
+
+  size_t leastLoaded();
+  double loadPerConnection() const;
+  void sampleBusyRatios();
+  void rebalance();
 
   EventLoop* baseLoop_;
   string name_;               // 名字
@@ -65,6 +107,13 @@ class EventLoopThreadPool : noncopyable
   int next_;
   std::vector<std::unique_ptr<EventLoopThread>> threads_;   // 线程 vector
   std::vector<EventLoop*> loops_;
+  Placement placement_;
+  PlacementCallback placementCallback_;
+  double rebalanceThreshold_;
+  RebalanceCallback rebalanceCallback_;
+  std::vector<LoadSample> samples_;   // for kLeastBusy and rebalancing
+  Timestamp sampleTime_;
+  TimerId sampleTimer_;
 };
 
 }  // namespace net
@@ -59,6 +59,12 @@ class Poller : noncopyable
   }
 
  protected:
+  /// Time poll() returns, from the clock of the loop.
+  Timestamp pollTime() const
+  {
+    return ownerLoop_->readClock();
+  }
+
   typedef std::map<int, Channel*> ChannelMap;
   ChannelMap channels_;     // std::map
 
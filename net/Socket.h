@@ -83,6 +83,19 @@ class Socket : noncopyable
   ///
   void setKeepAlive(bool on);
 
+  ///
+  /// Enable/disable SO_ZEROCOPY, needed by MSG_ZEROCOPY sends.
+  /// @return true if success.
+  ///
+  bool setZeroCopy(bool on);
+
+  ///
+  /// Sets SO_BUSY_POLL, receives spin on the device queue for up to
+  /// @c microSeconds.  Raising it above net.core.busy_read needs CAP_NET_ADMIN.
+  /// @return true if success.
+  ///
+  bool setBusyPoll(int microSeconds);
+
  private:
   const int sockfd_;
 };
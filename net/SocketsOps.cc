@@ -14,9 +14,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
 #include <stdio.h>  // snprintf
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/sendfile.h>
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 using namespace muduo;
@@ -183,6 +185,59 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int fileFd, off_t* offset, size_t count)
+{
+  return ::sendfile(sockfd, fileFd, offset, count);
+}
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+ssize_t sockets::sendZeroCopy(int sockfd, const void *buf, size_t count)
+{
+  return ::send(sockfd, buf, count, MSG_ZEROCOPY);
+}
+
+// 通知在 socket 的错误队列里，不是真正的错误
+int sockets::readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied)
+{
+  for (;;)
+  {
+    char control[128];
+    struct msghdr msg;
+    memZero(&msg, sizeof msg);
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+    {
+      return errno == EAGAIN ? 0 : -1;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+      if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+          || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+      {
+        const struct sock_extended_err* err =
+            reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+        if (err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+        {
+          *lo = err->ee_info;
+          *hi = err->ee_data;
+          *copied = (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+          return 1;
+        }
+      }
+    }
+    // something else on the error queue, e.g. an ICMP error, skip it
+  }
+}
+
 void sockets::close(int sockfd)
 {
   if (::close(sockfd) < 0)
@@ -200,6 +255,18 @@ void sockets::shutdownWrite(int sockfd)
   }
 }
 
+// connect 到 AF_UNSPEC 会断开 TCP 连接（发送 RST），socket 本身不关闭
+void sockets::abortConnection(int sockfd)
+{
+  struct sockaddr addr;
+  memZero(&addr, sizeof addr);
+  addr.sa_family = AF_UNSPEC;
+  if (::connect(sockfd, &addr, sizeof addr) < 0)
+  {
+    LOG_SYSERR << "sockets::abortConnection";
+  }
+}
+
 void sockets::toIpPort(char* buf, size_t size,
                        const struct sockaddr* addr)
 {
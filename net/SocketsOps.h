@@ -34,8 +34,19 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+ssize_t sendfile(int sockfd, int fileFd, off_t* offset, size_t count);
+/// send(2) with MSG_ZEROCOPY, buf must stay unchanged until completion.
+ssize_t sendZeroCopy(int sockfd, const void *buf, size_t count);
+/// Reads one MSG_ZEROCOPY completion from the socket error queue.
+/// Sends numbered [*lo, *hi] are done, *copied is set if the kernel
+/// fell back to copying.
+/// @return 1 if one is read, 0 if the error queue has none, -1 on error.
+int readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
+/// Resets the connection, the send queue is dropped, but sockfd stays open.
+void abortConnection(int sockfd);
 
 void toIpPort(char* buf, size_t size,
               const struct sockaddr* addr);
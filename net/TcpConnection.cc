@@ -14,12 +14,52 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/Socket.h"
 #include "muduo/net/SocketsOps.h"
+#include "muduo/net/poller/IoUringPoller.h"
+
+#include <algorithm>
+#include <limits>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+const size_t TcpConnection::kDefaultEventBudget;
+
+// 完成模式下 recv / sendmsg 操作的状态，msg 和 vec 在 sendmsg 完成前不能改动
+struct TcpConnection::CompletionState
+{
+  explicit CompletionState(IoUringPoller* poller)
+    : ring(poller)
+  {
+    memZero(&msg, sizeof msg);
+  }
+
+  IoUringPoller* ring;
+  IoUringPoller::OperationId recvId = 0;
+  IoUringPoller::OperationId sendId = 0;
+  uint64_t recvSeq = 0;       // completions of a cancelled recv are stale
+  size_t received = 0;        // bytes not passed to messageCallback_ yet
+  bool eof = false;
+  int recvErrno = 0;
+  bool sendQueued = false;
+  struct msghdr msg;
+  struct iovec vec[ChainBuffer::kMaxIovecs];
+};
+
+namespace
+{
+// how long a peer which stops reading may keep zero-copy sends pinned
+// after the connection is destroyed, before we reset it.
+const double kZeroCopyLingerSeconds = 10.0;
+}  // namespace
+
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
   LOG_TRACE << conn->localAddress().toIpPort() << " -> "
@@ -48,12 +88,19 @@ TcpConnection::TcpConnection(EventLoop* loop,
     name_(nameArg),
     state_(kConnecting),
     reading_(true),
+    zeroCopyEnabled_(false),
+    coalescing_(false),
+    completionRequested_(false),
     socket_(new Socket(sockfd)),
     channel_(new Channel(loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)      // 64M
+    highWaterMark_(64*1024*1024),     // 64M
+    eventBudget_(0),
+    flushQueued_(false),
+    migrating_(false)
 {
+  getLoop()->countConnection(1);
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, _1));
   channel_->setWriteCallback(
@@ -62,6 +109,9 @@ TcpConnection::TcpConnection(EventLoop* loop,
       std::bind(&TcpConnection::handleClose, this));
   channel_->setErrorCallback(
       std::bind(&TcpConnection::handleError, this));
+  // 缓冲区只在有数据时从 loop 的内存池借用存储空间
+  inputBuffer_.setPool(loop->bufferPool());
+  outputBuffer_.setPool(loop->bufferPool());
   LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
             << " fd=" << sockfd;
   
@@ -103,18 +153,22 @@ void TcpConnection::send(const StringPiece& message)
 {
   if (state_ == kConnected)
   {
-    if (loop_->isInLoopThread())
+    if (getLoop()->isInLoopThread())
     {
       // 当前线程中直接调用
       sendInLoop(message);
     }
+    else if (coalescing_)
+    {
+      stageSend(&message, 1);
+    }
     else
     {
       // 不在相同的线程中，将要执行的函数打包到关联的loop中执行
       // 声明一个 TcpConnection 内部的 函数指针
       void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
       // std::function<void()>
-      loop_->runInLoop(
+      runInOwnerLoop(
           std::bind(fp,
                     this,     // FIXME
                     message.as_string()));
@@ -124,22 +178,94 @@ void TcpConnection::send(const StringPiece& message)
   }
 }
 
+void TcpConnection::send(string&& message)
+{
+  if (state_ == kConnected)
+  {
+    if (getLoop()->isInLoopThread())
+    {
+      sendStringInLoop(message);
+    }
+    else if (coalescing_)
+    {
+      StringPiece piece(message);
+      stageSend(&piece, 1);
+    }
+    else
+    {
+      // 只移动 string，不拷贝数据
+      runInOwnerLoop(
+          std::bind(&TcpConnection::sendStringInLoop,
+                    this,     // FIXME
+                    std::move(message)));
+    }
+  }
+}
+
+// send(Buffer&&) 从其他线程交给 loop 的存储
+struct TcpConnection::StorageSend
+{
+  void operator()()
+  {
+    conn->sendInLoop(storage.data() + begin, end - begin);
+  }
+
+  TcpConnection* conn;
+  std::vector<char> storage;
+  size_t begin;
+  size_t end;
+};
+
+void TcpConnection::send(Buffer&& buf)
+{
+  if (state_ == kConnected)
+  {
+    if (getLoop()->isInLoopThread())
+    {
+      sendInLoop(buf.peek(), buf.readableBytes());
+      buf.retrieveAll();
+    }
+    else if (coalescing_)
+    {
+      StringPiece piece(buf.peek(), static_cast<int>(buf.readableBytes()));
+      stageSend(&piece, 1);
+      buf.retrieveAll();
+    }
+    else
+    {
+      // 只移动存储，比 bind 一个 Buffer 小，可以放进 Task 不必分配
+      static_assert(Task::storedInline<StorageSend>(),
+                    "a cross-thread send(Buffer&&) must not allocate");
+      StorageSend task;
+      task.conn = this;     // FIXME
+      task.storage = buf.takeStorage(&task.begin, &task.end);
+      runInOwnerLoop(std::move(task));
+    }
+  }
+}
+
 // FIXME efficiency!!! 高效率的
 void TcpConnection::send(Buffer* buf)
 {
   if (state_ == kConnected)
   {
-    if (loop_->isInLoopThread())
+    if (getLoop()->isInLoopThread())
     {
       // 将 buf 中的数据全部发送
       sendInLoop(buf->peek(), buf->readableBytes());
       // 重置 buf
       buf->retrieveAll();
     }
+    else if (coalescing_)
+    {
+      StringPiece piece(buf->peek(), static_cast<int>(buf->readableBytes()));
+      stageSend(&piece, 1);
+      buf->retrieveAll();
+    }
     else
     {
       void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-      loop_->runInLoop(
+      runInOwnerLoop(
           std::bind(fp,
                     this,     // FIXME
                     buf->retrieveAllAsString()));
@@ -148,6 +274,122 @@ void TcpConnection::send(Buffer* buf)
   }
 }
 
+void TcpConnection::send(const SharedPayload& payload)
+{
+  if (state_ == kConnected)
+  {
+    if (getLoop()->isInLoopThread())
+    {
+      sendPayloadInLoop(payload);
+    }
+    else
+    {
+      // 只拷贝智能指针，不拷贝数据
+      runInOwnerLoop(
+          std::bind(&TcpConnection::sendPayloadInLoop,
+                    this,     // FIXME
+                    payload));
+    }
+  }
+}
+
+void TcpConnection::sendv(const StringPiece* messages, size_t count)
+{
+  if (state_ == kConnected)
+  {
+    if (getLoop()->isInLoopThread())
+    {
+      sendvInLoop(messages, count);
+    }
+    else if (coalescing_)
+    {
+      stageSend(messages, count);
+    }
+    else
+    {
+      // the pieces may not outlive this call, so copy them once,
+      // the loop then keeps the string instead of copying it again
+      size_t len = 0;
+      for (size_t i = 0; i < count; ++i)
+      {
+        len += messages[i].size();
+      }
+      string message;
+      message.reserve(len);
+      for (size_t i = 0; i < count; ++i)
+      {
+        message.append(messages[i].data(), messages[i].size());
+      }
+      runInOwnerLoop(
+          std::bind(&TcpConnection::sendStringInLoop,
+                    this,     // FIXME
+                    std::move(message)));
+    }
+  }
+}
+
+// 追加到暂存区，只有第一次才通知 loop，之后的 send 只需要加锁拷贝
+void TcpConnection::stageSend(const StringPiece* messages, size_t count)
+{
+  bool queueFlush = false;
+  {
+    MutexLockGuard lock(stagingMutex_);
+    for (size_t i = 0; i < count; ++i)
+    {
+      staging_.append(messages[i].data(), messages[i].size());
+    }
+    if (!flushQueued_)
+    {
+      flushQueued_ = queueFlush = true;
+    }
+  }
+  if (queueFlush)
+  {
+    queueInOwnerLoop(std::bind(&TcpConnection::flushStaging, shared_from_this()), true);
+  }
+}
+
+// 把其他线程暂存的数据一次写出，在其他发送之前调用以保持顺序
+void TcpConnection::flushStaging()
+{
+  if (!coalescing_)
+  {
+    return;
+  }
+  getLoop()->assertInLoopThread();
+  {
+    MutexLockGuard lock(stagingMutex_);
+    if (staging_.readableBytes() == 0)
+    {
+      flushQueued_ = false;
+      return;
+    }
+    // flushing_ is empty but keeps its capacity, so is staging_ after the swap
+    staging_.swap(flushing_);
+    flushQueued_ = false;
+  }
+  sendInLoop(flushing_.peek(), flushing_.readableBytes(), NULL, NULL);
+  flushing_.retrieveAll();
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+  if (state_ == kConnected)
+  {
+    int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0)
+    {
+      LOG_SYSERR << "TcpConnection::sendFile";
+      return;
+    }
+    // sendFileInLoop owns dupFd from here on
+    runInOwnerLoop(
+        std::bind(&TcpConnection::sendFileInLoop,
+                  this,     // FIXME
+                  dupFd, offset, length));
+  }
+}
+
 // 在loop线程中发送数据
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
@@ -156,27 +398,129 @@ void TcpConnection::sendInLoop(const StringPiece& message)
 
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-  loop_->assertInLoopThread();
-  ssize_t nwrote = 0;
-  size_t remaining = len;
-  bool faultError = false;
+  flushStaging();
+  sendInLoop(data, len, NULL, NULL);
+}
+
+void TcpConnection::sendStringInLoop(string& message)
+{
+  flushStaging();
+  sendInLoop(message.data(), message.size(), NULL, &message);
+}
+
+
+void TcpConnection::sendPayloadInLoop(const SharedPayload& payload)
+{
+  flushStaging();
+  const size_t threshold = outputBuffer_.zeroCopyThreshold();
+  if (threshold > 0 && payload->size() >= threshold)
+  {
+    // 零拷贝必须经过输出缓冲区，由它持有 payload 直到内核发送完成
+    getLoop()->assertInLoopThread();
+    if (state_ == kDisconnected)
+    {
+      LOG_WARN << "disconnected, give up writing";
+      return;
+    }
+    const size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(payload);
+    writeQueuedOutput(oldLen);
+    return;
+  }
+  sendInLoop(payload->data(), payload->size(), &payload, NULL);
+}
+
+void TcpConnection::sendInLoop(const void* data, size_t len,
+                               const SharedPayload* payload, string* owned)
+{
+  struct iovec vec;
+  vec.iov_base = const_cast<void*>(data);
+  vec.iov_len = len;
+  const ssize_t nwrote = writeDirectly(&vec, 1, len);
+  // 出错、已断开或者全部写完
+  if (nwrote < 0 || implicit_cast<size_t>(nwrote) == len)
+  {
+    return;
+  }
+  // 没有发生错误，并且还有剩余的数据需要发送
+  const size_t remaining = len - nwrote;
+  if (payload)
+  {
+    outputBuffer_.append(*payload, nwrote);
+  }
+  else if (owned && remaining >= ChainBuffer::kMinSharedBytes)
+  {
+    // the caller gave the string up, keep it instead of copying the tail
+    outputBuffer_.append(std::make_shared<const string>(std::move(*owned)), nwrote);
+  }
+  else
+  {
+    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
+  }
+  startWriting();
+}
+
+// 与 sendInLoop 相同，只是直接写时用 writev，只把没写完的部分追加到输出缓冲区
+void TcpConnection::sendvInLoop(const StringPiece* messages, size_t count)
+{
+  getLoop()->assertInLoopThread();
+  flushStaging();
+  size_t len = 0;
+  struct iovec vec[ChainBuffer::kMaxIovecs];
+  int iovcnt = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    len += messages[i].size();
+    if (messages[i].size() > 0 && iovcnt < ChainBuffer::kMaxIovecs)
+    {
+      vec[iovcnt].iov_base = const_cast<char*>(messages[i].data());
+      vec[iovcnt].iov_len = messages[i].size();
+      ++iovcnt;
+    }
+  }
+  const ssize_t nwrote = writeDirectly(vec, iovcnt, len);
+  if (nwrote < 0 || implicit_cast<size_t>(nwrote) == len)
+  {
+    return;
+  }
+  // skip pieces already written, then queue the tails
+  size_t skip = implicit_cast<size_t>(nwrote);
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t n = messages[i].size();
+    if (skip >= n)
+    {
+      skip -= n;
+      continue;
+    }
+    outputBuffer_.append(messages[i].data() + skip, n - skip);
+    skip = 0;
+  }
+  startWriting();
+}
+
+// if no thing in output queue, try writing directly
+// 如果输出缓冲区中没有任何数据，直接写；完成模式总是排队，由 sendmsg 批量写出。
+// 没写完的部分由调用者追加到输出缓冲区，这里先检查高水位
+ssize_t TcpConnection::writeDirectly(const struct iovec* vec, int iovcnt, size_t len)
+{
+  getLoop()->assertInLoopThread();
   if (state_ == kDisconnected)
   {
     LOG_WARN << "disconnected, give up writing";
-    return;
+    return -1;
   }
-  // if no thing in output queue, try writing directly
-  // 如果输出缓冲区中没有任何数据，直接写
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  ssize_t nwrote = 0;
+  if (!completion_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
   {
-    nwrote = sockets::write(channel_->fd(), data, len);
+    nwrote = iovcnt == 1 ? sockets::write(channel_->fd(), vec[0].iov_base, vec[0].iov_len)
+                         : sockets::writev(channel_->fd(), vec, iovcnt);
     if (nwrote >= 0)
     {
-      remaining = len - nwrote;
-      if (remaining == 0 && writeCompleteCallback_)
+      if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_)
       {
         // 写入完成，并且有 写入完成回调函数
-        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        queueInOwnerLoop(std::bind(writeCompleteCallback_, shared_from_this()));
       }
     }
     else // nwrote < 0
@@ -188,28 +532,117 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         LOG_SYSERR << "TcpConnection::sendInLoop";
         if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
         {
-          faultError = true;
+          return -1;
         }
       }
     }
   }
 
-  assert(remaining <= len);
-  // 判断是否需要继续发送
-  if (!faultError && remaining > 0)
+  assert(implicit_cast<size_t>(nwrote) <= len);
+  const size_t remaining = len - nwrote;
+  const size_t oldLen = outputBuffer_.readableBytes();
+  if (remaining > 0
+      && oldLen + remaining >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    queueInOwnerLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+  }
+  return nwrote;
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+  getLoop()->assertInLoopThread();
+  flushStaging();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    ::close(fd);
+    return;
+  }
+  const size_t oldLen = outputBuffer_.readableBytes();
+  outputBuffer_.appendFile(fd, offset, length);
+  writeQueuedOutput(oldLen);
+}
+
+// 数据已追加到输出缓冲区，检查高水位，如果之前没有在写则立即写一次
+void TcpConnection::writeQueuedOutput(size_t oldLen)
+{
+  const size_t newLen = outputBuffer_.readableBytes();
+  if (newLen >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
   {
-    // 没有发生错误，并且还有剩余的数据需要发送
-    size_t oldLen = outputBuffer_.readableBytes();
-    if (oldLen + remaining >= highWaterMark_
-        && oldLen < highWaterMark_
-        && highWaterMarkCallback_)
+    queueInOwnerLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  if (completion_)
+  {
+    queueSend();
+  }
+  else if (!channel_->isWriting() && newLen > 0)
+  {
+    channel_->enableWriting();
+    handleWrite();
+  }
+}
+
+void TcpConnection::startWriting()
+{
+  if (completion_)
+  {
+    queueSend();
+  }
+  else if (!channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+}
+
+// 完成模式下，输出缓冲区有数据就表示还在写
+bool TcpConnection::isWritingOutput() const
+{
+  return channel_->isWriting() || (completion_ && outputBuffer_.readableBytes() > 0);
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+  runInOwnerLoop(
+      std::bind(&TcpConnection::setZeroCopyThresholdInLoop, this, threshold));
+}
+
+void TcpConnection::setZeroCopyThresholdInLoop(size_t threshold)
+{
+  getLoop()->assertInLoopThread();
+  if (completion_)
+  {
+    LOG_WARN << "TcpConnection [" << name_ << "] zero-copy is not supported in completion mode";
+    return;
+  }
+  if (threshold > 0 && !zeroCopyEnabled_)
+  {
+    zeroCopyEnabled_ = socket_->setZeroCopy(true);
+    if (!zeroCopyEnabled_)
     {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+      return;
     }
-    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-    if (!channel_->isWriting())
+  }
+  outputBuffer_.setZeroCopyThreshold(threshold);
+}
+
+// 读取错误队列中的完成通知，释放内核已经发送完的 payload
+void TcpConnection::handleZeroCopyCompletions()
+{
+  uint32_t lo = 0, hi = 0;
+  bool copied = false;
+  while (sockets::readZeroCopyCompletion(channel_->fd(), &lo, &hi, &copied) > 0)
+  {
+    outputBuffer_.onZeroCopyComplete(lo, hi);
+    if (copied && outputBuffer_.zeroCopyThreshold() > 0)
     {
-      channel_->enableWriting();
+      // e.g. loopback or a NIC without scatter-gather, pinning only adds cost
+      LOG_INFO << "TcpConnection [" << name_ << "] kernel copied zero-copy sends, turn it off";
+      outputBuffer_.setZeroCopyThreshold(0);
     }
   }
 }
@@ -221,14 +654,16 @@ void TcpConnection::shutdown()
   {
     setState(kDisconnecting);
     // FIXME: shared_from_this()?
-    loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+    runInOwnerLoop(std::bind(&TcpConnection::shutdownInLoop, this));
   }
 }
 
 void TcpConnection::shutdownInLoop()
 {
-  loop_->assertInLoopThread();
-  if (!channel_->isWriting())
+  getLoop()->assertInLoopThread();
+  // staged data goes out before FIN
+  flushStaging();
+  if (!isWritingOutput())
   {
     // we are not writing
     socket_->shutdownWrite();
@@ -241,19 +676,19 @@ void TcpConnection::shutdownInLoop()
 //   if (state_ == kConnected)
 //   {
 //     setState(kDisconnecting);
-//     loop_->runInLoop(std::bind(&TcpConnection::shutdownAndForceCloseInLoop, this, seconds));
+//     getLoop()->runInLoop(std::bind(&TcpConnection::shutdownAndForceCloseInLoop, this, seconds));
 //   }
 // }
 
 // void TcpConnection::shutdownAndForceCloseInLoop(double seconds)
 // {
-//   loop_->assertInLoopThread();
+//   getLoop()->assertInLoopThread();
 //   if (!channel_->isWriting())
 //   {
 //     // we are not writing
 //     socket_->shutdownWrite();
 //   }
-//   loop_->runAfter(
+//   getLoop()->runAfter(
 //       seconds,
 //       makeWeakCallback(shared_from_this(),
 //                        &TcpConnection::forceCloseInLoop));
@@ -265,7 +700,7 @@ void TcpConnection::forceClose()
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    queueInOwnerLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
   }
 }
 
@@ -274,7 +709,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->runAfter(
+    getLoop()->runAfter(
         seconds,
         makeWeakCallback(shared_from_this(),
                          &TcpConnection::forceClose));  // not forceCloseInLoop to avoid race condition
@@ -283,7 +718,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 
 void TcpConnection::forceCloseInLoop()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     // as if we received 0 byte in handleRead();
@@ -315,12 +750,30 @@ void TcpConnection::setTcpNoDelay(bool on)
 
 void TcpConnection::startRead()
 {
-  loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+  runInOwnerLoop(std::bind(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
+  if (completion_)
+  {
+    if (!reading_)
+    {
+      reading_ = true;
+      if (state_ == kConnected || state_ == kDisconnecting)
+      {
+        startRecv();
+      }
+      if (completion_->received > 0)
+      {
+        // received after stopRead(), before the recv was cancelled
+        getLoop()->queueInLoop(std::bind(&TcpConnection::handleCompletedRead,
+                                     shared_from_this(), Timestamp::now()));
+      }
+    }
+    return;
+  }
   if (!reading_ || !channel_->isReading())
   {
     channel_->enableReading();
@@ -330,12 +783,23 @@ void TcpConnection::startReadInLoop()
 
 void TcpConnection::stopRead()
 {
-  loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+  runInOwnerLoop(std::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
+  if (completion_)
+  {
+    if (reading_ && completion_->recvId != 0)
+    {
+      completion_->ring->cancelOperation(completion_->recvId);
+      completion_->recvId = 0;
+      ++completion_->recvSeq;
+    }
+    reading_ = false;
+    return;
+  }
   if (reading_ || channel_->isReading())
   {
     channel_->disableReading();
@@ -343,20 +807,168 @@ void TcpConnection::stopReadInLoop()
   }
 }
 
+void TcpConnection::runInOwnerLoop(Task cb)
+{
+  if (getLoop()->isInLoopThread())
+  {
+    cb();
+  }
+  else
+  {
+    queueInOwnerLoop(std::move(cb));
+  }
+}
+
+void TcpConnection::queueInOwnerLoop(Task cb, bool flush)
+{
+  MutexLockGuard lock(loopMutex_);
+  if (migrating_)
+  {
+    migrationQueue_.push_back(std::move(cb));
+  }
+  else if (flush)
+  {
+    getLoop()->queueFlush(std::move(cb));
+  }
+  else
+  {
+    getLoop()->queueInLoop(std::move(cb));
+  }
+}
+
+// 迁移中的连接等到达新的 loop 再销毁
+void TcpConnection::destroyInOwnerLoop()
+{
+  runInOwnerLoop(std::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+}
+
+void TcpConnection::migrate(EventLoop* loop)
+{
+  // 总是排队，等 loop 处理完这一轮的事件再迁移
+  queueInOwnerLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop));
+}
+
+void TcpConnection::migrateInLoop(EventLoop* loop)
+{
+  getLoop()->assertInLoopThread();
+  if (loop == getLoop() || state_ != kConnected)
+  {
+    return;
+  }
+  if (completion_)
+  {
+    // the recv and sendmsg in flight belong to the ring of this loop
+    LOG_WARN << "TcpConnection::migrate [" << name_ << "] not supported in completion mode";
+    return;
+  }
+  {
+  MutexLockGuard lock(loopMutex_);
+  if (migrating_)
+  {
+    // an earlier migrate() is on the way, go on from its loop
+    migrationQueue_.push_back(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop));
+    return;
+  }
+  migrating_ = true;
+  }
+  // 从这里开始其他线程的调用暂存在 migrationQueue_，
+  // detach after those already queued in this loop.
+  getLoop()->queueInLoop(std::bind(&TcpConnection::detachInLoop, shared_from_this(), loop));
+}
+
+void TcpConnection::detachInLoop(EventLoop* loop)
+{
+  getLoop()->assertInLoopThread();
+  // closed meanwhile, stays here to be destroyed
+  const bool moving = state_ != kDisconnected;
+  if (moving)
+  {
+    LOG_DEBUG << "TcpConnection::migrate [" << name_ << "] fd=" << channel_->fd()
+              << " to loop " << loop;
+    // 暂存区的数据先写出，保持顺序
+    flushStaging();
+    // deferred events are dropped too, attachInLoop() polls the fd again
+    channel_->disableAll();
+    channel_->remove();
+    channel_->setOwnerLoop(loop);
+    getLoop()->countConnection(-1);
+    loop->countConnection(1);
+    // storage holding data goes along, unpooled until attachInLoop()
+    // accounts it to the new pool, each pool is touched in its own thread
+    inputBuffer_.releaseToPool();
+    inputBuffer_.setPool(NULL);
+    outputBuffer_.setPool(NULL);
+  }
+
+  MutexLockGuard lock(loopMutex_);
+  if (moving)
+  {
+    loop_.store(loop, std::memory_order_release);
+    getLoop()->queueInLoop(std::bind(&TcpConnection::attachInLoop, shared_from_this()));
+  }
+  for (Task& cb : migrationQueue_)
+  {
+    getLoop()->queueInLoop(std::move(cb));
+  }
+  migrationQueue_.clear();
+  migrating_ = false;
+}
+
+// 在新的 loop 中重新注册，已经就绪的事件会再报告一次，边沿触发也不会丢失
+void TcpConnection::attachInLoop()
+{
+  getLoop()->assertInLoopThread();
+  inputBuffer_.setPool(getLoop()->bufferPool());
+  outputBuffer_.setPool(getLoop()->bufferPool());
+  if (state_ == kDisconnected)
+  {
+    return;
+  }
+  if (getLoop()->socketBusyPoll() > 0)
+  {
+    socket_->setBusyPoll(getLoop()->socketBusyPoll());
+  }
+  // registers the channel, then the events it needs
+  channel_->disableAll();
+  if (reading_)
+  {
+    channel_->enableReading();
+  }
+  if (outputBuffer_.readableBytes() > 0)
+  {
+    channel_->enableWriting();
+  }
+}
+
 void TcpConnection::connectEstablished()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
   channel_->tie(shared_from_this());
-  channel_->enableReading();
+  if (getLoop()->socketBusyPoll() > 0)
+  {
+    socket_->setBusyPoll(getLoop()->socketBusyPoll());
+  }
+  IoUringPoller* ring = getLoop()->ioUringPoller();
+  if (completionRequested_ && ring && ring->supportsCompletions())
+  {
+    completion_.reset(new CompletionState(ring));
+    // registered without events, it only reports completions
+    channel_->disableAll();
+    startRecv();
+  }
+  else
+  {
+    channel_->enableReading();
+  }
 
   connectionCallback_(shared_from_this());
 }
 
 void TcpConnection::connectDestroyed()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   if (state_ == kConnected)
   {
     setState(kDisconnected);
@@ -364,22 +976,111 @@ void TcpConnection::connectDestroyed()
 
     connectionCallback_(shared_from_this());
   }
+  if (completion_)
+  {
+    // the pending operations own this connection until they complete
+    if (completion_->recvId != 0)
+    {
+      completion_->ring->cancelOperation(completion_->recvId);
+      completion_->recvId = 0;
+      ++completion_->recvSeq;
+    }
+    if (completion_->sendId != 0)
+    {
+      completion_->ring->cancelOperation(completion_->sendId);
+    }
+  }
   channel_->remove();
+  getLoop()->countConnection(-1);
+  // give storage back while still in loop thread, we may be
+  // destructed in another one.
+  inputBuffer_.retrieveAll();
+  inputBuffer_.releaseToPool();
+  if (!completion_ || completion_->sendId == 0)
+  {
+    // otherwise the kernel may still read it, onSendComplete() retrieves it
+    outputBuffer_.retrieveAll();
+  }
+  // what is left is freed with the buffers, outside of the pool
+  inputBuffer_.setPool(NULL);
+  outputBuffer_.setPool(NULL);
+  if (outputBuffer_.numPinned() > 0)
+  {
+    // the kernel may still read pinned payloads, the socket stays open
+    // so its completions can be read, and keeps this connection alive
+    lingerZeroCopy(addTime(Timestamp::now(), kZeroCopyLingerSeconds), 0.001);
+  }
+}
+
+// 定时读取完成通知，直到所有 payload 都不再被内核引用
+void TcpConnection::lingerZeroCopy(Timestamp deadline, double interval)
+{
+  getLoop()->assertInLoopThread();
+  handleZeroCopyCompletions();
+  if (outputBuffer_.numPinned() == 0)
+  {
+    return;
+  }
+  if (deadline.valid() && Timestamp::now() > deadline)
+  {
+    // dropping the send queue releases its pages, completions follow
+    LOG_WARN << "TcpConnection [" << name_ << "] " << outputBuffer_.numPinned()
+             << " zero-copy sends pending, reset";
+    sockets::abortConnection(channel_->fd());
+    deadline = Timestamp::invalid();
+  }
+  getLoop()->runAfter(interval,
+      std::bind(&TcpConnection::lingerZeroCopy, shared_from_this(),
+                deadline, std::min(2 * interval, 0.1)));
+}
+
+void TcpConnection::setEdgeTriggered(bool on, size_t eventBudget)
+{
+  assert(state_ == kConnecting);
+  eventBudget_ = eventBudget;
+  channel_->setEdgeTriggered(on);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
+  if (completion_)
+  {
+    handleCompletedRead(receiveTime);
+    return;
+  }
+  if (channel_->isEdgeTriggered())
+  {
+    handleReadWithBudget(receiveTime);
+    return;
+  }
+  // 水平触发每个事件只读一次，没读完的下一次 poll 还会报告
+  const int64_t micros = getLoop()->channelTimeBudget();
+  const int64_t start = micros > 0 ? EventLoop::monotonicMicroSeconds() : 0;
   int savedErrno = 0;
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0)
   {
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    // idle connections don't hold buffer memory
+    inputBuffer_.releaseToPool();
+    // 用完预算的连接下一轮排在最后，并计入 deferredCount()
+    if (getLoop()->hasChannelBudget()
+        && channel_->isReading()
+        && (implicit_cast<size_t>(n) >= byteBudget()
+            || (micros > 0 && EventLoop::monotonicMicroSeconds() - start >= micros)))
+    {
+      getLoop()->deferChannel(get_pointer(channel_), POLLIN);
+    }
   }
   else if (n == 0)
   {
     handleClose();
   }
+  else if (savedErrno == EWOULDBLOCK)
+  {
+    // deferred, but the previous read had taken everything
+  }
   else
   {
     errno = savedErrno;
@@ -388,32 +1089,143 @@ void TcpConnection::handleRead(Timestamp receiveTime)
   }
 }
 
+size_t TcpConnection::byteBudget() const
+{
+  if (eventBudget_ > 0)
+  {
+    return eventBudget_;
+  }
+  if (getLoop()->channelByteBudget() > 0)
+  {
+    return getLoop()->channelByteBudget();
+  }
+  // level-triggered with only a time budget
+  return channel_->isEdgeTriggered() ? kDefaultEventBudget : std::numeric_limits<size_t>::max();
+}
+
+// 边沿触发：读到 EAGAIN 为止，但最多读 byteBudget() 字节、回调最多用 loop 规定的时间，
+// 用完则推迟到下一轮，让同一 loop 上的其他连接先处理
+void TcpConnection::handleReadWithBudget(Timestamp receiveTime)
+{
+  const size_t bytes = byteBudget();
+  const int64_t micros = getLoop()->channelTimeBudget();
+  const int64_t start = micros > 0 ? EventLoop::monotonicMicroSeconds() : 0;
+  size_t total = 0;
+  ssize_t n = 0;
+  int savedErrno = 0;
+  bool exhausted = false;
+  for (;;)
+  {
+    n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (n <= 0)
+    {
+      break;
+    }
+    total += n;
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    if (!channel_->isReading())
+    {
+      // stopRead() or closed in the callback
+      break;
+    }
+    if (total >= bytes
+        || (micros > 0 && EventLoop::monotonicMicroSeconds() - start >= micros))
+    {
+      exhausted = true;
+      break;
+    }
+  }
+  inputBuffer_.releaseToPool();
+
+  if (n == 0)
+  {
+    // the callback may have closed it already
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+      handleClose();
+    }
+  }
+  else if (n < 0)
+  {
+    if (savedErrno != EWOULDBLOCK)
+    {
+      errno = savedErrno;
+      LOG_SYSERR << "TcpConnection::handleRead";
+      handleError();
+    }
+  }
+  else if (exhausted && channel_->isReading())
+  {
+    // an edge-triggered fd won't be reported again for what is left
+    getLoop()->deferChannel(get_pointer(channel_), POLLIN);
+  }
+}
+
 void TcpConnection::handleWrite()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   if (channel_->isWriting())
   {
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    int savedErrno = 0;
+    // writev 写出多个 slab，已写出的部分在 writeFd 中回收
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    if (channel_->isEdgeTriggered())
+    {
+      // 写到 EAGAIN、写完或用完 budget 为止
+      size_t written = 0;
+      while (n > 0)
+      {
+        written += n;
+        if (outputBuffer_.readableBytes() == 0 || written >= byteBudget())
+        {
+          break;
+        }
+        n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+      }
+      if (n > 0 && outputBuffer_.readableBytes() > 0)
+      {
+        getLoop()->deferChannel(get_pointer(channel_), POLLOUT);
+      }
+      else if (n < 0 && savedErrno == EWOULDBLOCK)
+      {
+        // socket buffer is full, wait for the next edge
+        return;
+      }
+    }
     if (n > 0)
     {
-      outputBuffer_.retrieve(n);
       if (outputBuffer_.readableBytes() == 0)
       {
         channel_->disableWriting();
         if (writeCompleteCallback_)
         {
-          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+          queueInOwnerLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
         if (state_ == kDisconnecting)
         {
           shutdownInLoop();
         }
       }
+      else if (completion_)
+      {
+        // past the file region, go back to sendmsg
+        struct iovec vec;
+        if (outputBuffer_.peekIovec(&vec, 1) > 0)
+        {
+          channel_->disableWriting();
+          submitSend();
+        }
+      }
+    }
+    else if (savedErrno == ENODATA)
+    {
+      // a queued file got shorter, the byte stream can't be completed
+      LOG_ERROR << "TcpConnection::handleWrite [" << name_ << "] file truncated";
+      forceCloseInLoop();
     }
     else
     {
+      errno = savedErrno;
       LOG_SYSERR << "TcpConnection::handleWrite";
       // if (state_ == kDisconnecting)
       // {
@@ -430,7 +1242,7 @@ void TcpConnection::handleWrite()
 
 void TcpConnection::handleClose()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
   assert(state_ == kConnected || state_ == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
@@ -445,8 +1257,176 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+  if (zeroCopyEnabled_)
+  {
+    // POLLERR is also how the kernel reports zero-copy completions
+    handleZeroCopyCompletions();
+    int err = sockets::getSocketError(channel_->fd());
+    if (err != 0)
+    {
+      LOG_ERROR << "TcpConnection::handleError [" << name_
+                << "] - SO_ERROR = " << err << " " << strerror_tl(err);
+    }
+    return;
+  }
   int err = sockets::getSocketError(channel_->fd());
   LOG_ERROR << "TcpConnection::handleError [" << name_
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
+
+void TcpConnection::startRecv()
+{
+  CompletionState* c = get_pointer(completion_);
+  assert(c->recvId == 0);
+  c->recvId = c->ring->recvMultishot(
+      get_pointer(channel_),
+      std::bind(&TcpConnection::onRecvComplete, shared_from_this(), ++c->recvSeq, _1, _2));
+}
+
+// 在 IoUringPoller::poll() 中运行，只把数据追加到 inputBuffer_，
+// 由 handleCompletedRead() 在处理事件时调用 messageCallback_
+int TcpConnection::onRecvComplete(uint64_t seq, int res, unsigned flags)
+{
+  CompletionState* c = get_pointer(completion_);
+  const bool current = seq == c->recvSeq;
+  const bool more = flags & IORING_CQE_F_MORE;
+  if (current && !more)
+  {
+    c->recvId = 0;
+  }
+  const bool open = state_ == kConnected || state_ == kDisconnecting;
+  int revents = 0;
+  if (res > 0)
+  {
+    if (open)
+    {
+      inputBuffer_.append(c->ring->providedBuffer(flags), res);
+      c->received += res;
+      revents = POLLIN;
+    }
+    if (current && !more && reading_ && open)
+    {
+      // the kernel may end a multishot recv, e.g. when the CQ overflows
+      startRecv();
+    }
+  }
+  else if (res == 0)
+  {
+    c->eof = true;
+    revents = open ? POLLIN : 0;
+  }
+  else if (res == -ENOBUFS)
+  {
+    // all provided buffers were in use, they are given back by now
+    if (current && reading_ && open)
+    {
+      startRecv();
+    }
+  }
+  else if (res != -ECANCELED)
+  {
+    c->recvErrno = -res;
+    revents = open ? POLLIN : 0;
+  }
+  c->ring->recycleBuffer(flags);
+  return revents;
+}
+
+void TcpConnection::handleCompletedRead(Timestamp receiveTime)
+{
+  CompletionState* c = get_pointer(completion_);
+  if (c->received > 0 && reading_ && state_ != kDisconnected)
+  {
+    c->received = 0;
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    // idle connections don't hold buffer memory
+    inputBuffer_.releaseToPool();
+  }
+  if (c->recvErrno != 0)
+  {
+    errno = c->recvErrno;
+    c->recvErrno = 0;
+    LOG_SYSERR << "TcpConnection::handleRead";
+    handleError();
+    // the recv is over, and nothing else reports on this socket
+    c->eof = true;
+  }
+  if (c->eof && (state_ == kConnected || state_ == kDisconnecting))
+  {
+    handleClose();
+  }
+}
+
+// 本轮循环的所有 send 追加完之后，再用一个 sendmsg 写出
+void TcpConnection::queueSend()
+{
+  CompletionState* c = get_pointer(completion_);
+  if (!c->sendQueued && c->sendId == 0)
+  {
+    c->sendQueued = true;
+    getLoop()->queueFlush(std::bind(&TcpConnection::submitSend, shared_from_this()));
+  }
+}
+
+void TcpConnection::submitSend()
+{
+  CompletionState* c = get_pointer(completion_);
+  c->sendQueued = false;
+  if (state_ == kDisconnected || c->sendId != 0 || channel_->isWriting()
+      || outputBuffer_.readableBytes() == 0)
+  {
+    return;
+  }
+  int iovcnt = outputBuffer_.peekIovec(c->vec, ChainBuffer::kMaxIovecs);
+  if (iovcnt == 0)
+  {
+    // a file region is at the front, sendfile(2) it on readiness
+    channel_->enableWriting();
+    handleWrite();
+    return;
+  }
+  c->msg.msg_iov = c->vec;
+  c->msg.msg_iovlen = iovcnt;
+  c->sendId = c->ring->sendmsg(
+      get_pointer(channel_), &c->msg,
+      std::bind(&TcpConnection::onSendComplete, shared_from_this(), _1, _2));
+}
+
+// 在 IoUringPoller::poll() 中运行，回收已发送的数据，还有数据则提交下一个 sendmsg
+int TcpConnection::onSendComplete(int res, unsigned)
+{
+  CompletionState* c = get_pointer(completion_);
+  c->sendId = 0;
+  if (state_ == kDisconnected)
+  {
+    outputBuffer_.retrieveAll();
+    return 0;
+  }
+  if (res >= 0)
+  {
+    outputBuffer_.retrieve(res);
+    if (outputBuffer_.readableBytes() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      if (state_ == kDisconnecting)
+      {
+        shutdownInLoop();
+      }
+    }
+    else
+    {
+      // goes out with the next io_uring_enter(2)
+      submitSend();
+    }
+  }
+  else if (res != -ECANCELED)
+  {
+    errno = -res;
+    LOG_SYSERR << "TcpConnection::handleWrite";
+  }
+  return 0;
+}
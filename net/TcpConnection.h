@@ -11,19 +11,26 @@
 #ifndef MUDUO_NET_TCPCONNECTION_H
 #define MUDUO_NET_TCPCONNECTION_H
 
+#include "muduo/base/Mutex.h"
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/StringPiece.h"
+#include "muduo/base/Task.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
+#include "muduo/net/ChainBuffer.h"
 #include "muduo/net/InetAddress.h"
 
+#include <atomic>
+#include <initializer_list>
 #include <memory>
+#include <vector>
 
 #include <boost/any.hpp>
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
+struct iovec;
 
 namespace muduo
 {
@@ -52,7 +59,8 @@ class TcpConnection : noncopyable,
                 const InetAddress& peerAddr);
   ~TcpConnection();
 
-  EventLoop* getLoop() const { return loop_; }
+  /// Changes when the connection migrates, see migrate().
+  EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
   const string& name() const { return name_; }
   const InetAddress& localAddress() const { return localAddr_; }
   const InetAddress& peerAddress() const { return peerAddr_; }
@@ -64,11 +72,42 @@ class TcpConnection : noncopyable,
   bool getTcpInfo(struct tcp_info*) const;
   string getTcpInfoString() const;
 
-  // void send(string&& message); // C++11
+  // 移动语义：跨线程发送时只移动 string/Buffer，不拷贝数据
+  void send(string&& message); // C++11
   void send(const void* message, int len);
   void send(const StringPiece& message);
-  // void send(Buffer&& message); // C++11
+  void send(const char* message)  // or a literal is ambiguous between the two above
+  { send(StringPiece(message)); }
+  void send(Buffer&& message); // C++11
   void send(Buffer* message);  // this one will swap data
+  // 广播用：多个连接共享同一份数据，未写完的部分只保存引用
+  void send(const SharedPayload& payload);  // thread safe, never copies a large payload
+  // 分散写：多段数据（如报头和正文）用一次 writev 发出，不需要先拼接
+  void sendv(const StringPiece* messages, size_t count);
+  void sendv(std::initializer_list<StringPiece> messages)
+  { sendv(messages.begin(), messages.size()); }
+  // 发送文件的 [offset, offset+length)，排在已有输出数据之后，用 sendfile 发送
+  // fd is dup'ed, the caller may close its own fd right after this returns.
+  void sendFile(int fd, off_t offset, size_t length);
+  // 零拷贝：不小于 threshold 的 SharedPayload 用 MSG_ZEROCOPY 发送，0 表示关闭
+  // Turned off again if the kernel reports it had to copy anyway.
+  void setZeroCopyThreshold(size_t threshold = ChainBuffer::kDefaultZeroCopyThreshold);
+  // 边沿触发：每个事件读/写到 EAGAIN 或用完 eventBudget 字节，用完则留到下一轮
+  // Call before connectEstablished(), TcpServer::setEdgeTriggered() does it.
+  // eventBudget 0 uses the loop's channel budget, or kDefaultEventBudget if it has none.
+  static const size_t kDefaultEventBudget = 256*1024;
+  void setEdgeTriggered(bool on, size_t eventBudget = 0);
+  // 写合并：其他线程的 send 先追加到暂存区，loop 每轮循环只写一次
+  // Call before sending from other threads.
+  void setWriteCoalescing(bool on)
+  { coalescing_ = on; }
+  // 完成模式：用 io_uring 的 multishot recv 读，sendmsg 在每轮循环结束时批量提交
+  // Needs MUDUO_USE_IO_URING, otherwise the connection stays in readiness mode.
+  // Call before connectEstablished(), TcpServer::setCompletionMode() does it.
+  // Callbacks and buffers behave the same, edge-triggered and budgets don't apply.
+  void setCompletionMode(bool on)
+  { completionRequested_ = on; }
+  bool completionMode() const { return completion_ != nullptr; }
 
   // 非线程安全的操作，不可以在其他线程中调用该函数
   void shutdown(); // NOT thread safe, no simultaneous calling
@@ -81,6 +120,18 @@ class TcpConnection : noncopyable,
   void stopRead();
   bool isReading() const { return reading_; }; // NOT thread safe, may race with start/stopReadInLoop
 
+  ///
+  /// Moves the connection to @c loop.  Thread safe.
+  ///
+  /// The move happens at the end of the current iteration of the
+  /// connection's loop, never inside one of its callbacks.  Buffered data,
+  /// the context and the callbacks are kept, and callbacks run in @c loop
+  /// from then on.  Sends from other threads during the move are held and
+  /// keep their order.  Timers added to the old loop stay there.
+  /// Does nothing if not connected, and in completion mode.
+  /// Don't migrate a TcpClient's connection, only a TcpServer's.
+  void migrate(EventLoop* loop);
+
   void setContext(const boost::any& context)
   { context_ = context; }
 
@@ -106,7 +157,7 @@ class TcpConnection : noncopyable,
   Buffer* inputBuffer()
   { return &inputBuffer_; }
 
-  Buffer* outputBuffer()
+  ChainBuffer* outputBuffer()
   { return &outputBuffer_; }
 
   /// Internal use only.
@@ -117,16 +168,46 @@ class TcpConnection : noncopyable,
   void connectEstablished();   // should be called only once
   // called when TcpServer has removed me from its map
   void connectDestroyed();  // should be called only once
+  // connectDestroyed() for a connection that may be migrating, thread safe
+  void destroyInOwnerLoop();
 
  private:
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+  struct CompletionState;
+  struct StorageSend;
   void handleRead(Timestamp receiveTime);
+  void handleReadWithBudget(Timestamp receiveTime);
+  size_t byteBudget() const;
   void handleWrite();
   void handleClose();
   void handleError();
-  // void sendInLoop(string&& message);
+  void startWriting();
+  bool isWritingOutput() const;
+  // completion mode
+  void startRecv();
+  int onRecvComplete(uint64_t seq, int res, unsigned flags);
+  void handleCompletedRead(Timestamp receiveTime);
+  void queueSend();
+  void submitSend();
+  int onSendComplete(int res, unsigned flags);
+  void sendStringInLoop(string& message);  // may move from message
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
+  void sendPayloadInLoop(const SharedPayload& payload);
+  void sendvInLoop(const StringPiece* messages, size_t count);
+  void sendFileInLoop(int fd, off_t offset, size_t length);
+  void writeQueuedOutput(size_t oldLen);
+  void setZeroCopyThresholdInLoop(size_t threshold);
+  void handleZeroCopyCompletions();
+  void lingerZeroCopy(Timestamp deadline, double interval);
+  void stageSend(const StringPiece* messages, size_t count);
+  void flushStaging();
+  // if payload is not NULL, message is its data and the unwritten tail is queued by reference.
+  // if owned is not NULL, message is its data and a long unwritten tail moves it into outputBuffer_.
+  void sendInLoop(const void* message, size_t len, const SharedPayload* payload, string* owned);
+  // writes directly if nothing is queued, checks the high water mark for the rest.
+  // @return bytes written, -1 if nothing should be queued (disconnected or broken).
+  ssize_t writeDirectly(const struct iovec* vec, int iovcnt, size_t len);
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
   void forceCloseInLoop();
@@ -134,16 +215,26 @@ class TcpConnection : noncopyable,
   const char* stateToString() const;
   void startReadInLoop();
   void stopReadInLoop();
-
-  EventLoop* loop_;
+  void migrateInLoop(EventLoop* loop);
+  void detachInLoop(EventLoop* loop);
+  void attachInLoop();
+  // 其他线程的调用都经过这里，迁移期间暂存，迁移后按顺序交给新的 loop
+  void runInOwnerLoop(Task cb);
+  void queueInOwnerLoop(Task cb, bool flush = false);
+
+  std::atomic<EventLoop*> loop_;   // changed by migrate() in the old loop thread, under loopMutex_
   const string name_;
   StateE state_;  // FIXME: use atomic variable 使用原子变量
   bool reading_;
+  bool zeroCopyEnabled_;  // SO_ZEROCOPY is on
+  bool coalescing_;
+  bool completionRequested_;
   
   // we don't expose those classes to client.
   // 每个TcpConnection 都绑定唯一的 socket 和 channel
   std::unique_ptr<Socket> socket_;
   std::unique_ptr<Channel> channel_;
+  std::unique_ptr<CompletionState> completion_;   // NULL in readiness mode
 
   const InetAddress localAddr_;               // 本机地址
   const InetAddress peerAddr_;                // 对端地址
@@ -155,9 +246,17 @@ class TcpConnection : noncopyable,
   HighWaterMarkCallback highWaterMarkCallback_;   // 高水位回调函数
   CloseCallback closeCallback_;                   // 关闭回调函数
   size_t highWaterMark_;                      // 高水位
+  size_t eventBudget_;                        // 每个事件最多读写的字节数，0 表示用 loop 的设置
   // 输入输出 缓冲区
   Buffer inputBuffer_;
-  Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  ChainBuffer outputBuffer_;   // slab 链表，追加数据不移动已有数据
+  MutexLock stagingMutex_;
+  Buffer staging_ GUARDED_BY(stagingMutex_);   // 其他线程的 send，由 flushStaging() 写出
+  bool flushQueued_ GUARDED_BY(stagingMutex_);
+  Buffer flushing_;   // swapped with staging_ in the loop thread
+  MutexLock loopMutex_;
+  bool migrating_ GUARDED_BY(loopMutex_);
+  std::vector<Task> migrationQueue_ GUARDED_BY(loopMutex_);   // calls during migrate()
 
   // 万能变量
   boost::any context_;
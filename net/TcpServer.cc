@@ -8,6 +8,7 @@
 
 #include "muduo/net/TcpServer.h"
 
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/Acceptor.h"
 #include "muduo/net/EventLoop.h"
@@ -19,6 +20,24 @@
 using namespace muduo;
 using namespace muduo::net;
 
+// kReusePortPerLoop 模式下一个 IO loop 的监听器和连接表，只在该 loop 中访问
+struct TcpServer::LoopListener
+{
+  LoopListener(EventLoop* ioLoop, const InetAddress& listenAddr, int idx)
+    : loop(ioLoop),
+      acceptor(new Acceptor(ioLoop, listenAddr, true)),
+      index(idx),
+      nextConnId(1)
+  {
+  }
+
+  EventLoop* loop;
+  std::unique_ptr<Acceptor> acceptor;
+  const int index;
+  int nextConnId;
+  ConnectionMap connections;
+};
+
 TcpServer::TcpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
                      const string& nameArg,
@@ -26,15 +45,24 @@ TcpServer::TcpServer(EventLoop* loop,
   : loop_(CHECK_NOTNULL(loop)),
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    listenAddr_(listenAddr),
+    acceptor_(option == kReusePortPerLoop
+              ? NULL : new Acceptor(loop, listenAddr, option == kReusePort)),
     threadPool_(new EventLoopThreadPool(loop, name_)),
     connectionCallback_(defaultConnectionCallback),
     messageCallback_(defaultMessageCallback),
-    nextConnId_(1)
+    nextConnId_(1),
+    edgeTriggered_(false),
+    eventBudget_(0),
+    completionMode_(false)
 {
   // 接受器 设置连接回调函数
-  acceptor_->setNewConnectionCallback(
-      std::bind(&TcpServer::newConnection, this, _1, _2));
+  if (acceptor_)
+  {
+    listenAddr_ = acceptor_->localAddress();
+    acceptor_->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnection, this, _1, _2));
+  }
 }
 
 TcpServer::~TcpServer()
@@ -48,9 +76,20 @@ TcpServer::~TcpServer()
     TcpConnectionPtr conn(item.second);
     // std::shared_ptr::reset()
     item.second.reset();
-    // conn 所在线程执行 连接销毁函数
-    conn->getLoop()->runInLoop(
-      std::bind(&TcpConnection::connectDestroyed, conn));
+    // conn 所在线程执行 连接销毁函数，迁移中的连接在新的 loop 中执行
+    conn->destroyInOwnerLoop();
+  }
+
+  // 各个 loop 关闭自己的监听器和连接，等它们都完成
+  if (!listeners_.empty())
+  {
+    CountDownLatch latch(static_cast<int>(listeners_.size()));
+    for (const auto& listener : listeners_)
+    {
+      listener->loop->runInLoop(
+          std::bind(&TcpServer::stopListener, this, get_pointer(listener), &latch));
+    }
+    latch.wait();
   }
 }
 
@@ -61,16 +100,56 @@ void TcpServer::setThreadNum(int numThreads)
   threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setPlacement(Placement placement)
+{
+  static_assert(kLeastBusy == static_cast<int>(EventLoopThreadPool::kLeastBusy),
+                "same placements as EventLoopThreadPool");
+  threadPool_->setPlacement(static_cast<EventLoopThreadPool::Placement>(placement));
+}
+
+void TcpServer::setPlacementCallback(const PlacementCallback& cb)
+{
+  threadPool_->setPlacementCallback(cb);
+}
+
+void TcpServer::setRebalancing(double busyThreshold)
+{
+  threadPool_->setRebalanceCallback(busyThreshold,
+      std::bind(&TcpServer::rebalance, this, _1, _2, _3));
+}
+
 void TcpServer::start()
 {
   if (started_.getAndSet(1) == 0)
   {
     threadPool_->start(threadInitCallback_);
 
-    assert(!acceptor_->listenning());
-    // 在主线程循环中 运行 Acceptor 的 listen 函数
-    loop_->runInLoop(
-        std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+    if (acceptor_)
+    {
+      assert(!acceptor_->listenning());
+      // 在主线程循环中 运行 Acceptor 的 listen 函数
+      loop_->runInLoop(
+          std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+    }
+    else
+    {
+      // 每个 IO loop 绑定同一个端口，在自己的线程中 listen 和 accept
+      for (EventLoop* ioLoop : threadPool_->getAllLoops())
+      {
+        LoopListener* listener =
+            new LoopListener(ioLoop, listenAddr_, static_cast<int>(listeners_.size()));
+        listeners_.emplace_back(listener);
+        if (listenAddr_.toPort() == 0)
+        {
+          // 端口 0：其余的 loop 绑定内核为第一个选择的端口
+          listenAddr_ = listener->acceptor->localAddress();
+        }
+        listener->acceptor->setNewConnectionCallback(
+            std::bind(&TcpServer::newLocalConnection, this, listener, _1, _2));
+        ioLoop->runInLoop(
+            std::bind(&Acceptor::listen, get_pointer(listener->acceptor)));
+      }
+    }
   }
 }
 
@@ -88,6 +167,42 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
   LOG_INFO << "TcpServer::newConnection [" << name_
            << "] - new connection [" << connName
            << "] from " << peerAddr.toIpPort();
+  TcpConnectionPtr conn = createConnection(ioLoop, connName, sockfd, peerAddr);
+  // 设置连接名称
+  connections_[connName] = conn;
+  conn->setCloseCallback(
+      std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+  // 工作线程 运行 connectEstablished
+  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+}
+
+// 在 IO loop 中接受的新连接，直接加入本 loop 的连接表
+void TcpServer::newLocalConnection(LoopListener* listener,
+                                   int sockfd,
+                                   const InetAddress& peerAddr)
+{
+  listener->loop->assertInLoopThread();
+  char buf[64];
+  snprintf(buf, sizeof buf, "-%s#%d.%d",
+           ipPort_.c_str(), listener->index, listener->nextConnId);
+  ++listener->nextConnId;
+  string connName = name_ + buf;
+
+  LOG_INFO << "TcpServer::newLocalConnection [" << name_
+           << "] - new connection [" << connName
+           << "] from " << peerAddr.toIpPort();
+  TcpConnectionPtr conn = createConnection(listener->loop, connName, sockfd, peerAddr);
+  listener->connections[connName] = conn;
+  conn->setCloseCallback(
+      std::bind(&TcpServer::removeLocalConnection, this, listener, _1)); // FIXME: unsafe
+  conn->connectEstablished();
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop,
+                                             const string& connName,
+                                             int sockfd,
+                                             const InetAddress& peerAddr)
+{
   // 获得本地的 ip地址信息
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
@@ -97,16 +212,19 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
                                           sockfd,
                                           localAddr,
                                           peerAddr));
-  // 设置连接名称
-  connections_[connName] = conn;
   // 设置回调函数
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
-  conn->setCloseCallback(
-      std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
-  // 工作线程 运行 connectEstablished
-  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+  if (edgeTriggered_)
+  {
+    conn->setEdgeTriggered(true, eventBudget_);
+  }
+  if (completionMode_)
+  {
+    conn->setCompletionMode(true);
+  }
+  return conn;
 }
 
 // 其他线程可以调用 
@@ -128,4 +246,76 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
   EventLoop* ioLoop = conn->getLoop();
   ioLoop->queueInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
+
+// 迁移走的连接仍然登记在接受它的 loop 中
+void TcpServer::removeLocalConnection(LoopListener* listener, const TcpConnectionPtr& conn)
+{
+  // FIXME: unsafe
+  listener->loop->runInLoop(
+      std::bind(&TcpServer::removeLocalConnectionInLoop, this, listener, conn));
+}
+
+void TcpServer::removeLocalConnectionInLoop(LoopListener* listener,
+                                            const TcpConnectionPtr& conn)
+{
+  listener->loop->assertInLoopThread();
+  LOG_INFO << "TcpServer::removeLocalConnectionInLoop [" << name_
+           << "] - connection " << conn->name();
+  size_t n = listener->connections.erase(conn->name());
+  (void)n;
+  assert(n == 1);
+  conn->getLoop()->queueInLoop(
+      std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void TcpServer::stopListener(LoopListener* listener, CountDownLatch* latch)
+{
+  listener->loop->assertInLoopThread();
+  listener->acceptor.reset();
+  for (auto& item : listener->connections)
+  {
+    TcpConnectionPtr conn(item.second);
+    item.second.reset();
+    conn->destroyInOwnerLoop();
+  }
+  listener->connections.clear();
+  latch->countDown();
+}
+
+// 从忙碌的 loop 迁移 count 个连接
+void TcpServer::rebalance(EventLoop* from, EventLoop* to, int count)
+{
+  loop_->assertInLoopThread();
+  LOG_INFO << "TcpServer::rebalance [" << name_ << "] - moving " << count
+           << " connections from loop " << from << " to loop " << to;
+  if (listeners_.empty())
+  {
+    migrateConnections(&connections_, from, to, count);
+    return;
+  }
+  // 连接表只能在自己的 loop 中访问，迁移 from 自己接受的连接
+  for (const auto& listener : listeners_)
+  {
+    if (listener->loop == from)
+    {
+      from->runInLoop(std::bind(&TcpServer::migrateConnections, this,
+                                &listener->connections, from, to, count));
+    }
+  }
+}
+
+void TcpServer::migrateConnections(ConnectionMap* connections,
+                                   EventLoop* from, EventLoop* to, int count)
+{
+  for (ConnectionMap::iterator it = connections->begin();
+       it != connections->end() && count > 0; ++it)
+  {
+    const TcpConnectionPtr& conn = it->second;
+    if (conn->getLoop() == from && conn->connected())
+    {
+      conn->migrate(to);
+      --count;
+    }
+  }
+}
@@ -18,9 +18,13 @@
 #include "muduo/net/TcpConnection.h"
 
 #include <map>
+#include <vector>
 
 namespace muduo
 {
+
+class CountDownLatch;
+
 namespace net
 {
 
@@ -42,7 +46,22 @@ class TcpServer : noncopyable
   {
     kNoReusePort,
     kReusePort,
+    /// 每个 IO loop 有自己的 SO_REUSEPORT 监听 socket 和连接表，
+    /// 新连接在本线程 accept，不经过 base loop。
+    /// The kernel spreads new connections over the listeners, so
+    /// setPlacement() doesn't apply.  With port 0 the first listener
+    /// binds a port chosen by the kernel and the others bind it too.
+    kReusePortPerLoop,
+  };
+  /// 新连接分配给哪个线程, see EventLoopThreadPool::Placement
+  enum Placement
+  {
+    kRoundRobin,
+    kLeastConnections,
+    kLeastQueued,
+    kLeastBusy,
   };
+  typedef std::function<EventLoop*(const std::vector<EventLoop*>&)> PlacementCallback;
 
   //TcpServer(EventLoop* loop, const InetAddress& listenAddr);
   TcpServer(EventLoop* loop,
@@ -53,21 +72,42 @@ class TcpServer : noncopyable
 
   const string& ipPort() const { return ipPort_; }
   const string& name() const { return name_; }
+  /// 端口为 0 时返回内核选择的端口，kReusePortPerLoop 在 start() 之后
+  /// Not thread safe, but in loop's thread or after start().
+  const InetAddress& listenAddress() const { return listenAddr_; }
   EventLoop* getLoop() const { return loop_; }
 
   /// Set the number of threads for handling input.
   ///
-  /// Always accepts new connection in loop's thread.
+  /// Always accepts new connection in loop's thread,
+  /// except with kReusePortPerLoop.
   /// Must be called before @c start   必须在 start 函数前调用
   /// @param numThreads
   /// - 0 means all I/O in loop's thread, no thread will created.
   ///   this is the default value.
   /// - 1 means all I/O in another thread.
   /// - N means a thread pool with N threads, new connections
-  ///   are assigned on a round-robin basis.
+  ///   are assigned on a round-robin basis, see setPlacement().
   void setThreadNum(int numThreads);
   void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
+  /// With N threads, assigns new connections to the thread with the
+  /// fewest connections, the shortest functor queue, or the lowest recent
+  /// busy time, instead of round-robin.
+  /// Must be called before @c start
+  void setPlacement(Placement placement);
+  /// Picks the loop of each new connection, overrides setPlacement().
+  /// Must be called before @c start
+  void setPlacementCallback(const PlacementCallback& cb);
+  /// With N threads, when the busy time of a thread stays above
+  /// @c busyThreshold (0 to 1) for a second, part of its connections
+  /// migrate to the least busy thread, see TcpConnection::migrate().
+  /// Any connection may move at any time, while a timer added with
+  /// conn->getLoop()->runAfter() stays in the old loop and would touch
+  /// the connection from there: forward such callbacks to
+  /// conn->getLoop() when they fire, or don't enable this.
+  /// Must be called before @c start
+  void setRebalancing(double busyThreshold);
   /// valid after calling start()
   std::shared_ptr<EventLoopThreadPool> threadPool()
   { return threadPool_; }
@@ -93,6 +133,19 @@ class TcpServer : noncopyable
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }
 
+  /// Registers new connections edge-triggered with epoll, each read or
+  /// write event drains up to @c eventBudget bytes, 0 uses the budget of
+  /// the connection's loop, see EventLoop::setChannelBudget().
+  /// Not thread safe, affects connections accepted afterwards.
+  void setEdgeTriggered(bool on, size_t eventBudget = 0)
+  { edgeTriggered_ = on; eventBudget_ = eventBudget; }
+
+  /// New connections read and write with io_uring operations instead of
+  /// readiness events, see TcpConnection::setCompletionMode().
+  /// Not thread safe, affects connections accepted afterwards.
+  void setCompletionMode(bool on)
+  { completionMode_ = on; }
+
  private:
   /// Not thread safe, but in loop 多线程中不安全，但是在单循环中ok
   void newConnection(int sockfd, const InetAddress& peerAddr);
@@ -100,14 +153,31 @@ class TcpServer : noncopyable
   void removeConnection(const TcpConnectionPtr& conn);
   /// Not thread safe, but in loop 在当前线程中删除
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  /// Not thread safe, but in loop
+  void rebalance(EventLoop* from, EventLoop* to, int count);
 
   // 存储客户端连接 map
   typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+  struct LoopListener;
+
+  TcpConnectionPtr createConnection(EventLoop* ioLoop,
+                                    const string& connName,
+                                    int sockfd,
+                                    const InetAddress& peerAddr);
+  void migrateConnections(ConnectionMap* connections,
+                          EventLoop* from, EventLoop* to, int count);
+  /// kReusePortPerLoop, in the loop of the listener
+  void newLocalConnection(LoopListener* listener, int sockfd, const InetAddress& peerAddr);
+  /// Thread safe.
+  void removeLocalConnection(LoopListener* listener, const TcpConnectionPtr& conn);
+  void removeLocalConnectionInLoop(LoopListener* listener, const TcpConnectionPtr& conn);
+  void stopListener(LoopListener* listener, CountDownLatch* latch);
 
   EventLoop* loop_;  // the acceptor loop
   const string ipPort_;
   const string name_;
-  std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor 接受器(接受来自客户端的连接) 使用唯一智能指针防止内存泄漏
+  InetAddress listenAddr_;  // the bound port if it was 0
+  std::unique_ptr<Acceptor> acceptor_; // NULL with kReusePortPerLoop, avoid revealing Acceptor 接受器(接受来自客户端的连接) 使用唯一智能指针防止内存泄漏
   std::shared_ptr<EventLoopThreadPool> threadPool_;   // 线程池
 
   // 回调函数
@@ -120,7 +190,12 @@ class TcpServer : noncopyable
   AtomicInt32 started_;
   // always in loop thread 轮询算法
   int nextConnId_;
+  bool edgeTriggered_;
+  size_t eventBudget_;
+  bool completionMode_;
   ConnectionMap connections_;
+  // one for each IO loop with kReusePortPerLoop
+  std::vector<std::unique_ptr<LoopListener>> listeners_;
 };
 
 }  // namespace net
@@ -18,10 +18,31 @@ void Timer::restart(Timestamp now)
 {
   if (repeat_)
   {
-    expiration_ = addTime(now, interval_);
+    expiration_ = coalesce(addTime(now, interval_), grid_);
   }
   else
   {
     expiration_ = Timestamp::invalid();
   }
 }
+
+int64_t Timer::gridOf(double slack)
+{
+  int64_t microseconds = static_cast<int64_t>(slack * Timestamp::kMicroSecondsPerSecond);
+  if (microseconds <= 0)
+  {
+    return 0;
+  }
+  // 不超过 slack 的最大的 2 的幂
+  return int64_t(1) << (63 - __builtin_clzll(static_cast<uint64_t>(microseconds)));
+}
+
+Timestamp Timer::coalesce(Timestamp when, int64_t grid)
+{
+  if (grid <= 1 || !when.valid())
+  {
+    return when;
+  }
+  int64_t microseconds = when.microSecondsSinceEpoch();
+  return Timestamp((microseconds + grid - 1) / grid * grid);
+}
@@ -17,6 +17,8 @@
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 
+#include <atomic>
+
 namespace muduo
 {
 namespace net
@@ -29,14 +31,42 @@ namespace net
 class Timer : noncopyable
 {
  public:
-  Timer(TimerCallback cb, Timestamp when, double interval)
+  Timer(TimerCallback cb, Timestamp when, double interval, double slack = 0.0)
     : callback_(std::move(cb)),
-      expiration_(when),
+      grid_(gridOf(slack)),
+      expiration_(coalesce(when, grid_)),
       interval_(interval),
       repeat_(interval > 0.0),
-      sequence_(s_numCreated_.incrementAndGet())
+      sequence_(s_numCreated_.incrementAndGet()),
+      canceled_(false),
+      heapIndex_(-1),
+      prevInSlot_(NULL),
+      nextInSlot_(NULL),
+      slot_(-1)
   { }
 
+  /// 从 TimerQueue 的空闲池中取出后重新使用，序列号是新的
+  /// Reuses a released timer, a TimerId of its previous use never
+  /// matches again.
+  void reuse(TimerCallback cb, Timestamp when, double interval, double slack)
+  {
+    callback_ = std::move(cb);
+    grid_ = gridOf(slack);
+    expiration_ = coalesce(when, grid_);
+    interval_ = interval;
+    repeat_ = interval > 0.0;
+    canceled_ = false;
+    sequence_.store(s_numCreated_.incrementAndGet(), std::memory_order_relaxed);
+  }
+
+  /// Drops the callback, and whatever it holds, before the timer goes
+  /// back to the pool.
+  void release()
+  {
+    callback_ = nullptr;
+    sequence_.store(0, std::memory_order_relaxed);
+  }
+
   void run() const
   {
     callback_();
@@ -44,19 +74,49 @@ class Timer : noncopyable
 
   Timestamp expiration() const  { return expiration_; }
   bool repeat() const { return repeat_; }
-  int64_t sequence() const { return sequence_; }
+  /// Expirations are multiples of it, 0 if exact.
+  int64_t gridMicroSeconds() const { return grid_; }
+  /// May be read in the loop thread while another thread reuses the timer.
+  int64_t sequence() const { return sequence_.load(std::memory_order_relaxed); }
+
+  /// Canceled while it runs, or before the loop added it.
+  bool canceled() const { return canceled_; }
+  void cancel() { canceled_ = true; }
+
+  /// In a TimerHeap or a TimingWheel.
+  bool queued() const { return heapIndex_ >= 0 || slot_ >= 0; }
 
   void restart(Timestamp now);
 
   // 获得当前创建了多少个时间器
   static int64_t numCreated() { return s_numCreated_.get(); }
 
+  /// 松弛时间：到期时间向上取整到不超过 slack 的 2 的幂（微秒）的倍数，
+  /// so that timers with some slack fall on the same expirations and
+  /// share a wakeup.  A grid of a larger slack is a subset of the grids of
+  /// smaller ones.
+  static int64_t gridOf(double slack);
+  static Timestamp coalesce(Timestamp when, int64_t grid);
+
+  std::atomic<Timer*> next;           // free list of TimerQueue, see MpscNodePool
+
  private:
-  const TimerCallback callback_;
+  TimerCallback callback_;
+  int64_t grid_;                      // 0 if no slack
   Timestamp expiration_;              // 超时时间戳
-  const double interval_;             // 间隔
-  const bool repeat_;                 // 是否重复
-  const int64_t sequence_;            // 序列
+  double interval_;                   // 间隔
+  bool repeat_;                       // 是否重复
+  std::atomic<int64_t> sequence_;     // 序列, 0 if released
+  bool canceled_;
+
+  int heapIndex_;                     // -1 if not in a heap
+  friend class TimerHeap;
+
+  // TimingWheel 的侵入式链表
+  Timer* prevInSlot_;
+  Timer* nextInSlot_;
+  int slot_;                          // -1 if not in a wheel
+  friend class TimingWheel;
 
   static AtomicInt64 s_numCreated_;   // 创建数量
 };
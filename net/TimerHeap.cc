@@ -0,0 +1,119 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/TimerHeap.h"
+
+#include "muduo/net/Timer.h"
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+bool TimerHeap::add(Timer* timer)
+{
+  assert(timer->heapIndex_ < 0);
+  Node node = { timer->expiration().microSecondsSinceEpoch(), timer };
+  heap_.push_back(node);
+  siftUp(heap_.size() - 1, node);
+  return timer->heapIndex_ == 0;
+}
+
+void TimerHeap::remove(Timer* timer)
+{
+  assert(timer->heapIndex_ >= 0);
+  size_t index = static_cast<size_t>(timer->heapIndex_);
+  assert(heap_[index].timer == timer);
+  removeAt(index);
+}
+
+void TimerHeap::popExpired(Timestamp now, std::vector<Timer*>* expired)
+{
+  const int64_t microseconds = now.microSecondsSinceEpoch();
+  while (!heap_.empty() && heap_[0].when <= microseconds)
+  {
+    expired->push_back(heap_[0].timer);
+    removeAt(0);
+  }
+}
+
+void TimerHeap::takeAll(std::vector<Timer*>* timers)
+{
+  for (const Node& node : heap_)
+  {
+    node.timer->heapIndex_ = -1;
+    timers->push_back(node.timer);
+  }
+  heap_.clear();
+}
+
+void TimerHeap::place(size_t index, const Node& node)
+{
+  heap_[index] = node;
+  node.timer->heapIndex_ = static_cast<int>(index);
+}
+
+void TimerHeap::siftUp(size_t index, Node node)
+{
+  while (index > 0)
+  {
+    size_t parent = (index - 1) / kArity;
+    if (heap_[parent].when <= node.when)
+    {
+      break;
+    }
+    place(index, heap_[parent]);
+    index = parent;
+  }
+  place(index, node);
+}
+
+void TimerHeap::siftDown(size_t index, Node node)
+{
+  const size_t n = heap_.size();
+  while (true)
+  {
+    size_t first = index * kArity + 1;
+    if (first >= n)
+    {
+      break;
+    }
+    size_t last = first + kArity < n ? first + kArity : n;
+    size_t least = first;
+    for (size_t child = first + 1; child < last; ++child)
+    {
+      if (heap_[child].when < heap_[least].when)
+      {
+        least = child;
+      }
+    }
+    if (node.when <= heap_[least].when)
+    {
+      break;
+    }
+    place(index, heap_[least]);
+    index = least;
+  }
+  place(index, node);
+}
+
+void TimerHeap::removeAt(size_t index)
+{
+  heap_[index].timer->heapIndex_ = -1;
+  Node last = heap_.back();
+  heap_.pop_back();
+  if (index < heap_.size())
+  {
+    // 用最后一个节点填补空位，向上或向下调整
+    if (index > 0 && last.when < heap_[(index - 1) / kArity].when)
+    {
+      siftUp(index, last);
+    }
+    else
+    {
+      siftDown(index, last);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+// 四叉堆：按到期时间排列的时间器，时间器记住自己在堆中的位置
+
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_TIMERHEAP_H
+#define MUDUO_NET_TIMERHEAP_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Timer;
+
+///
+/// Intrusive 4-ary min-heap of timers, the default storage of TimerQueue.
+///
+/// Each timer keeps its index in the heap, so remove() needs no lookup.
+/// The expiration is copied next to the pointer, sifting compares
+/// without touching the timers.  A 4-ary heap is half as deep as a binary
+/// one, and the four children are next to each other in memory.
+///
+class TimerHeap : noncopyable
+{
+ public:
+  /// @return true if the timer expires before all the others.
+  bool add(Timer* timer);
+  void remove(Timer* timer);
+
+  /// Moves out timers expired by @c now, earliest first.
+  void popExpired(Timestamp now, std::vector<Timer*>* expired);
+  /// Moves out all timers, in no particular order.
+  void takeAll(std::vector<Timer*>* timers);
+
+  /// Invalid if empty.
+  Timestamp nextExpiration() const
+  {
+    return heap_.empty() ? Timestamp::invalid() : Timestamp(heap_[0].when);
+  }
+
+  size_t size() const { return heap_.size(); }
+
+ private:
+  struct Node
+  {
+    int64_t when;     // microseconds since epoch
+    Timer* timer;
+  };
+
+  static const size_t kArity = 4;
+
+  void place(size_t index, const Node& node);
+  void siftUp(size_t index, Node node);
+  void siftDown(size_t index, Node node);
+  void removeAt(size_t index);
+
+  std::vector<Node> heap_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TIMERHEAP_H
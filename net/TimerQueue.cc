@@ -16,6 +16,7 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/Timer.h"
 #include "muduo/net/TimerId.h"
+#include "muduo/net/TimingWheel.h"
 
 #include <sys/timerfd.h>
 #include <unistd.h>
@@ -41,10 +42,11 @@ int createTimerfd()
 
 // 计算 when 到现在的时间
 // now === when
-struct timespec howMuchTimeFromNow(Timestamp when)
+// now is read from the clock the timers use, e.g. the coarse one
+struct timespec howMuchTimeFromNow(Timestamp when, Timestamp now)
 {
   int64_t microseconds = when.microSecondsSinceEpoch()
-                         - Timestamp::now().microSecondsSinceEpoch();
+                         - now.microSecondsSinceEpoch();
   // 最小的时间间隔
   if (microseconds < 100)
   {
@@ -71,7 +73,7 @@ void readTimerfd(int timerfd, Timestamp now)
 }
 
 // wake up loop by timerfd_settime()
-void resetTimerfd(int timerfd, Timestamp expiration)
+void resetTimerfd(int timerfd, Timestamp expiration, Timestamp now)
 {  
 //      struct timespec {
 //                time_t tv_sec;                /* Seconds */
@@ -85,7 +87,7 @@ void resetTimerfd(int timerfd, Timestamp expiration)
   struct itimerspec oldValue;
   memZero(&newValue, sizeof newValue);
   memZero(&oldValue, sizeof oldValue);
-  newValue.it_value = howMuchTimeFromNow(expiration);
+  newValue.it_value = howMuchTimeFromNow(expiration, now);
   // 0 表示使用相对时间
   int ret = ::timerfd_settime(timerfd, 0, &newValue, &oldValue);
   if (ret)
@@ -102,39 +104,82 @@ using namespace muduo;
 using namespace muduo::net;
 using namespace muduo::net::detail;
 
-TimerQueue::TimerQueue(EventLoop* loop)
+TimerQueue::TimerQueue(EventLoop* loop, bool useTimerfd,
+                       int64_t wheelTickMicroSeconds)
   : loop_(loop),
-    timerfd_(createTimerfd()),
+    timerfd_(useTimerfd ? createTimerfd() : -1),
     timerfdChannel_(loop, timerfd_),
     timers_(),
-    callingExpiredTimers_(false)
+    wheel_(wheelTickMicroSeconds > 0
+           ? new TimingWheel(loop->readClock(), wheelTickMicroSeconds)
+           : NULL),
+    numTimers_(0)
 {
-  // 设置读取回调函数
-  timerfdChannel_.setReadCallback(
-      std::bind(&TimerQueue::handleRead, this));
-  // we are always reading the timerfd, we disarm it with timerfd_settime.
-  timerfdChannel_.enableReading();
+  if (timerfd_ >= 0)
+  {
+    // 设置读取回调函数
+    timerfdChannel_.setReadCallback(
+        std::bind(&TimerQueue::handleRead, this));
+    // we are always reading the timerfd, we disarm it with timerfd_settime.
+    timerfdChannel_.enableReading();
+  }
 }
 
 TimerQueue::~TimerQueue()
 {
-  timerfdChannel_.disableAll();
-  timerfdChannel_.remove();
-  ::close(timerfd_);
+  if (timerfd_ >= 0)
+  {
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+  }
   // do not remove channel, since we're in EventLoop::dtor();
-  for (const Entry& timer : timers_)
+  // 删除 Timer, the free ones are deleted by pool_
+  expired_.clear();
+  if (wheel_)
   {
-    // 删除 Timer
-    delete timer.second;
+    wheel_->takeAll(&expired_);
+  }
+  else
+  {
+    timers_.takeAll(&expired_);
+  }
+  for (Timer* timer : expired_)
+  {
+    delete timer;
+  }
+  MutexLockGuard lock(mutex_);
+  for (Timer* timer : unpooled_)
+  {
+    delete timer;
   }
 }
 
 // 添加时间器
 TimerId TimerQueue::addTimer(TimerCallback cb,
                              Timestamp when,
-                             double interval)
+                             double interval,
+                             double slack)
 {
-  Timer* timer = new Timer(std::move(cb), when, interval);
+  Timer* timer = pool_.get();
+  if (!timer)
+  {
+    MutexLockGuard lock(mutex_);
+    if (!unpooled_.empty())
+    {
+      timer = unpooled_.back();
+      unpooled_.pop_back();
+    }
+  }
+  if (timer)
+  {
+    timer->reuse(std::move(cb), when, interval, slack);
+  }
+  else
+  {
+    timer = new Timer(std::move(cb), when, interval, slack);
+  }
+  numTimers_.fetch_add(1, std::memory_order_relaxed);
   loop_->runInLoop(
       std::bind(&TimerQueue::addTimerInLoop, this, timer));
   return TimerId(timer, timer->sequence());
@@ -149,133 +194,182 @@ void TimerQueue::cancel(TimerId timerId)
 void TimerQueue::addTimerInLoop(Timer* timer)
 {
   loop_->assertInLoopThread();
+  if (timer->canceled())
+  {
+    // canceled before it was added
+    release(timer);
+    return;
+  }
   bool earliestChanged = insert(timer);
 
-  if (earliestChanged)
+  // without timerfd, the loop takes the new timeout before it polls again
+  if (earliestChanged && timerfd_ >= 0)
   {
-    resetTimerfd(timerfd_, timer->expiration());
+    resetTimerfd(timerfd_, timer->expiration(), loop_->readClock());
   }
 }
 
 void TimerQueue::cancelInLoop(TimerId timerId)
 {
   loop_->assertInLoopThread();
-  assert(timers_.size() == activeTimers_.size());
-  ActiveTimer timer(timerId.timer_, timerId.sequence_);
-  // 判断要删除的时间器是否正在使用中
-  ActiveTimerSet::iterator it = activeTimers_.find(timer);
-  if (it != activeTimers_.end())
+  Timer* timer = timerId.timer_;
+  // 已经到期、取消或被重新使用的时间器，序列号不同
+  if (timer == NULL || timer->sequence() != timerId.sequence_)
+  {
+    return;
+  }
+  if (timer->queued())
   {
-    size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
-    assert(n == 1); (void)n;
-    delete it->first; // FIXME: no delete please
-    activeTimers_.erase(it);
+    if (wheel_)
+    {
+      wheel_->remove(timer);
+    }
+    else
+    {
+      timers_.remove(timer);
+    }
+    release(timer);
   }
-  else if (callingExpiredTimers_)
+  else
   {
-    cancelingTimers_.insert(timer);
+    // it is running now, or its addTimerInLoop() is still pending
+    timer->cancel();
   }
-  assert(timers_.size() == activeTimers_.size());
 }
 
 void TimerQueue::handleRead()
 {
   loop_->assertInLoopThread();
-  Timestamp now(Timestamp::now());
+  // with a cached clock, the time poll returned is after the timerfd fired
+  Timestamp now(loop_->clockMode() == EventLoop::kPreciseClock
+                ? Timestamp::now() : loop_->now());
   readTimerfd(timerfd_, now);
+  runExpired(now);
+}
+
+int TimerQueue::pollTimeout(int maxMs) const
+{
+  loop_->assertInLoopThread();
+  Timestamp next = earliest();
+  if (!next.valid())
+  {
+    return maxMs;
+  }
+  int64_t microseconds = next.microSecondsSinceEpoch()
+                         - loop_->readClock().microSecondsSinceEpoch();
+  if (microseconds <= 0)
+  {
+    return 0;
+  }
+  // 向上取整，避免提前醒来后空转
+  int64_t ms = (microseconds + 999) / 1000;
+  return ms < maxMs ? static_cast<int>(ms) : maxMs;
+}
+
+void TimerQueue::runExpiredTimers()
+{
+  loop_->assertInLoopThread();
+  assert(timerfd_ < 0);
+  // poll waited until the earliest expiration, no need to read the clock
+  if (size() > 0)
+  {
+    runExpired(loop_->now());
+  }
+}
+
+void TimerQueue::runExpired(Timestamp now)
+{
+  // 粗时钟最多落后一个 tick，最早的时间器在这个范围内时读一次精确时钟。
+  // timerfd and poll timeouts never end early, so it has expired by then,
+  // otherwise the loop would wake up again and again until the clock ticks.
+  if (loop_->clockMode() == EventLoop::kCoarseClock)
+  {
+    static const int64_t resolution = Timestamp::coarseResolution();
+    Timestamp next = earliest();
+    if (next.valid()
+        && now < next
+        && next.microSecondsSinceEpoch() <= now.microSecondsSinceEpoch() + resolution)
+    {
+      now = Timestamp::now();
+    }
+  }
 
   // 获得已到期的所有时间器
-  std::vector<Entry> expired = getExpired(now);
+  expired_.clear();
+  getExpired(now);
 
-  callingExpiredTimers_ = true;
-  cancelingTimers_.clear();
   // safe to callback outside critical section
-  for (const Entry& it : expired)
+  for (Timer* timer : expired_)
   {
-    it.second->run();
+    timer->run();
   }
-  callingExpiredTimers_ = false;
 
   // 重置已经处理过的时间器
-  reset(expired, now);
+  reset(now);
 }
 
 // 获得所有到期的时间
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
+void TimerQueue::getExpired(Timestamp now)
 {
-  assert(timers_.size() == activeTimers_.size());
-  std::vector<Entry> expired;
-  Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
-  TimerList::iterator end = timers_.lower_bound(sentry);
-  assert(end == timers_.end() || now < end->first);
-  std::copy(timers_.begin(), end, back_inserter(expired));
-  timers_.erase(timers_.begin(), end);
-
-  for (const Entry& it : expired)
+  if (wheel_)
   {
-    ActiveTimer timer(it.second, it.second->sequence());
-    size_t n = activeTimers_.erase(timer);
-    assert(n == 1); (void)n;
+    wheel_->advance(now, &expired_);
+  }
+  else
+  {
+    timers_.popExpired(now, &expired_);
   }
-
-  assert(timers_.size() == activeTimers_.size());
-  return expired;
 }
 
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
+void TimerQueue::reset(Timestamp now)
 {
-  Timestamp nextExpire;
-
-  for (const Entry& it : expired)
+  for (Timer* timer : expired_)
   {
-    ActiveTimer timer(it.second, it.second->sequence());
-    if (it.second->repeat()
-        && cancelingTimers_.find(timer) == cancelingTimers_.end())
+    // 重复的时间器原地重新调度，不分配内存
+    if (timer->repeat() && !timer->canceled())
     {
-      it.second->restart(now);
-      insert(it.second);
+      timer->restart(now);
+      insert(timer);
     }
     else
     {
-      // FIXME move to a free list
-      delete it.second; // FIXME: no delete please
+      release(timer);
     }
   }
+  expired_.clear();
 
-  if (!timers_.empty())
-  {
-    nextExpire = timers_.begin()->second->expiration();
-  }
-
-  if (nextExpire.valid())
+  Timestamp nextExpire = earliest();
+  if (nextExpire.valid() && timerfd_ >= 0)
   {
-    resetTimerfd(timerfd_, nextExpire);
+    resetTimerfd(timerfd_, nextExpire, loop_->readClock());
   }
 }
 
 bool TimerQueue::insert(Timer* timer)
 {
   loop_->assertInLoopThread();
-  assert(timers_.size() == activeTimers_.size());
-  bool earliestChanged = false;
-  Timestamp when = timer->expiration();
-  TimerList::iterator it = timers_.begin();
-  if (it == timers_.end() || when < it->first)
-  {
-    earliestChanged = true;
-  }
-  {
-    std::pair<TimerList::iterator, bool> result
-      = timers_.insert(Entry(when, timer));
-    assert(result.second); (void)result;
-  }
+  return wheel_ ? wheel_->add(timer) : timers_.add(timer);
+}
+
+void TimerQueue::release(Timer* timer)
+{
+  assert(!timer->queued());
+  timer->release();
+  numTimers_.fetch_sub(1, std::memory_order_relaxed);
+  if (!pool_.put(timer))
   {
-    std::pair<ActiveTimerSet::iterator, bool> result
-      = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
-    assert(result.second); (void)result;
+    // a TimerId may still point to it, keep it for addTimer()
+    MutexLockGuard lock(mutex_);
+    unpooled_.push_back(timer);
   }
+}
 
-  assert(timers_.size() == activeTimers_.size());
-  return earliestChanged;
+Timestamp TimerQueue::earliest() const
+{
+  return wheel_ ? wheel_->nextExpiration() : timers_.nextExpiration();
 }
 
+size_t TimerQueue::size() const
+{
+  return wheel_ ? wheel_->size() : timers_.size();
+}
@@ -14,13 +14,17 @@
 #ifndef MUDUO_NET_TIMERQUEUE_H
 #define MUDUO_NET_TIMERQUEUE_H
 
-#include <set>
+#include <atomic>
+#include <memory>
 #include <vector>
 
+#include "muduo/base/MpscQueue.h"
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/Timer.h"
+#include "muduo/net/TimerHeap.h"
 
 namespace muduo
 {
@@ -28,8 +32,8 @@ namespace net
 {
 
 class EventLoop;
-class Timer;
 class TimerId;
+class TimingWheel;
 
 ///
 /// A best efforts timer queue.
@@ -38,7 +42,12 @@ class TimerId;
 class TimerQueue : noncopyable
 {
  public:
-  explicit TimerQueue(EventLoop* loop);
+  /// Without a timerfd, the owner loop polls with pollTimeout() and calls
+  /// runExpiredTimers() after polling.
+  /// Timers are kept in a TimingWheel if @c wheelTickMicroSeconds > 0,
+  /// otherwise in a TimerHeap.
+  explicit TimerQueue(EventLoop* loop, bool useTimerfd = true,
+                      int64_t wheelTickMicroSeconds = 0);
   ~TimerQueue();
 
   ///
@@ -47,42 +56,59 @@ class TimerQueue : noncopyable
   /// 
   /// Must be thread safe. Usually be called from other threads.
   /// 必须是线程安全的，通常都是在其他的线程中调用
+  /// May run up to @c slack seconds late, see Timer::gridOf().
   TimerId addTimer(TimerCallback cb,
                    Timestamp when,
-                   double interval);
+                   double interval,
+                   double slack = 0.0);
 
+  /// O(1) to find the timer, a released timer has another sequence.
   void cancel(TimerId timerId);
 
- private:
+  /// Timers added and not yet expired or canceled, including those still
+  /// on their way from other threads.  Thread safe.
+  int64_t numTimers() const { return numTimers_.load(std::memory_order_relaxed); }
+
+  // without timerfd 不使用 timerfd 时由 EventLoop 调用
 
-  // FIXME: use unique_ptr<Timer> instead of raw pointers.
-  // This requires heterogeneous comparison lookup (N3465) from C++14
-  // so that we can find an T* in a set<unique_ptr<T>>.
-  typedef std::pair<Timestamp, Timer*> Entry;
-  typedef std::set<Entry> TimerList;
-  typedef std::pair<Timer*, int64_t> ActiveTimer;
-  typedef std::set<ActiveTimer> ActiveTimerSet;
+  /// Milliseconds until the earliest timer, rounded up, at most @c maxMs.
+  int pollTimeout(int maxMs) const;
+  /// Runs timers expired by the time poll returned.
+  void runExpiredTimers();
 
+ private:
   void addTimerInLoop(Timer* timer);
   void cancelInLoop(TimerId timerId);
   // called when timerfd alarms 处理时间警报
   void handleRead();
-  // move out all expired timers
-  std::vector<Entry> getExpired(Timestamp now);
-  void reset(const std::vector<Entry>& expired, Timestamp now);
+  void runExpired(Timestamp now);
+  // move out all expired timers, into expired_
+  void getExpired(Timestamp now);
+  void reset(Timestamp now);
 
   bool insert(Timer* timer);
+  // 放回空闲池
+  void release(Timer* timer);
+  // invalid if no timer
+  Timestamp earliest() const;
+  size_t size() const;
 
   EventLoop* loop_;             // 关联的 eventloop
-  const int timerfd_;           // 时间器队列文件描述符
+  const int timerfd_;           // 时间器队列文件描述符, -1 if not used
   Channel timerfdChannel_;      // 时间器队列的channel
-  // Timer list sorted by expiration ； set
-  TimerList timers_;
-
-  // for cancel()
-  ActiveTimerSet activeTimers_;
-  bool callingExpiredTimers_; /* atomic */
-  ActiveTimerSet cancelingTimers_;
+  // Timers sorted by expiration ； 四叉堆
+  TimerHeap timers_;
+  // 时间轮，非空时代替 timers_
+  std::unique_ptr<TimingWheel> wheel_;
+  std::vector<Timer*> expired_;
+  std::atomic<int64_t> numTimers_;
+
+  // Released timers are reused, and never freed while the queue lives,
+  // so cancel() may always read the sequence of the timer of a TimerId.
+  MpscNodePool<Timer> pool_;
+  // 池放不下的（地址超出 48 位）放在这里，同样可以重用
+  MutexLock mutex_;
+  std::vector<Timer*> unpooled_ GUARDED_BY(mutex_);
 };
 
 }  // namespace net
@@ -0,0 +1,266 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/TimingWheel.h"
+
+#include "muduo/base/Types.h"
+#include "muduo/net/Timer.h"
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+TimingWheel::TimingWheel(Timestamp start, int64_t tickMicroSeconds)
+  : start_(start.microSecondsSinceEpoch()),
+    tick_(tickMicroSeconds),
+    current_(0),
+    size_(0)
+{
+  assert(tick_ > 0);
+  memZero(counts_, sizeof counts_);
+  memZero(slots_, sizeof slots_);
+  memZero(occupied_, sizeof occupied_);
+}
+
+TimingWheel::~TimingWheel()
+{
+  // timers are owned by TimerQueue
+}
+
+bool TimingWheel::add(Timer* timer)
+{
+  assert(timer->slot_ < 0);
+  int64_t before = nextTick();
+  int64_t expires = tickOf(timer->expiration());
+  link(timer, expires);
+  return expires < before;
+}
+
+void TimingWheel::remove(Timer* timer)
+{
+  unlink(timer);
+}
+
+void TimingWheel::advance(Timestamp now, std::vector<Timer*>* expired)
+{
+  int64_t microseconds = now.microSecondsSinceEpoch() - start_;
+  if (microseconds < 0)
+  {
+    return;
+  }
+  // the last tick that has ended
+  int64_t target = microseconds / tick_;
+  while (current_ <= target)
+  {
+    if (size_ == 0)
+    {
+      current_ = target + 1;
+      break;
+    }
+
+    int index = static_cast<int>(current_ & kMask);
+    if (index == 0)
+    {
+      // 第 0 层转完一圈，上层的下一个槽位降级
+      for (int level = 1; level < kLevels && cascade(level) == 0; ++level)
+      {
+      }
+    }
+
+    Timer* timer = slots_[0][index];
+    while (timer)
+    {
+      Timer* next = timer->nextInSlot_;
+      unlink(timer);
+      expired->push_back(timer);
+      timer = next;
+    }
+    ++current_;
+
+    // 第 0 层为空时，直接跳到下一次降级
+    if (counts_[0] == 0 && (current_ & kMask) != 0)
+    {
+      int64_t wrap = (current_ | kMask) + 1;
+      current_ = wrap < target + 1 ? wrap : target + 1;
+    }
+  }
+}
+
+void TimingWheel::takeAll(std::vector<Timer*>* timers)
+{
+  for (int level = 0; level < kLevels; ++level)
+  {
+    for (int index = 0; index < kSlots && counts_[level] > 0; ++index)
+    {
+      while (Timer* timer = slots_[level][index])
+      {
+        unlink(timer);
+        timers->push_back(timer);
+      }
+    }
+  }
+  assert(size_ == 0);
+}
+
+Timestamp TimingWheel::nextExpiration() const
+{
+  if (size_ == 0)
+  {
+    return Timestamp::invalid();
+  }
+  return timeOf(nextTick());
+}
+
+int64_t TimingWheel::tickOf(Timestamp when) const
+{
+  int64_t microseconds = when.microSecondsSinceEpoch() - start_;
+  // 向上取整，时间器不会提前到期
+  return microseconds <= 0 ? 0 : (microseconds + tick_ - 1) / tick_;
+}
+
+Timestamp TimingWheel::timeOf(int64_t tick) const
+{
+  return Timestamp(start_ + tick * tick_);
+}
+
+int64_t TimingWheel::nextTick() const
+{
+  int64_t next = INT64_MAX;
+  if (counts_[0] > 0)
+  {
+    next = current_ + firstOccupied(0, static_cast<int>(current_ & kMask));
+  }
+  // a timer on a higher level comes down no earlier than its slot cascades
+  for (int level = 1; level < kLevels; ++level)
+  {
+    if (counts_[level] > 0)
+    {
+      int shift = kSlotBits * level;
+      // the first slot yet to cascade, the current one if current_ is
+      // on its boundary
+      int64_t block = (current_ + (int64_t(1) << shift) - 1) >> shift;
+      int distance = firstOccupied(level, static_cast<int>(block & kMask));
+      int64_t cascade = (block + distance) << shift;
+      if (cascade < next)
+      {
+        next = cascade;
+      }
+    }
+  }
+  return next;
+}
+
+void TimingWheel::link(Timer* timer, int64_t expires)
+{
+  if (expires < current_)
+  {
+    expires = current_;
+  }
+  int64_t delta = expires - current_;
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (int64_t(1) << (kSlotBits * (level + 1))))
+  {
+    ++level;
+  }
+  const int64_t kRange = int64_t(1) << (kSlotBits * kLevels);
+  if (delta >= kRange)
+  {
+    // 太远的时间器放在最后一层的最远槽位，降级时重新计算
+    expires = current_ + kRange - 1;
+  }
+  int index = static_cast<int>((expires >> (kSlotBits * level)) & kMask);
+
+  Timer*& head = slots_[level][index];
+  timer->prevInSlot_ = NULL;
+  timer->nextInSlot_ = head;
+  if (head)
+  {
+    head->prevInSlot_ = timer;
+  }
+  head = timer;
+  timer->slot_ = level * kSlots + index;
+  occupied_[level][index / 64] |= uint64_t(1) << (index % 64);
+  ++counts_[level];
+  ++size_;
+}
+
+void TimingWheel::unlink(Timer* timer)
+{
+  assert(timer->slot_ >= 0);
+  int level = timer->slot_ / kSlots;
+  int index = timer->slot_ % kSlots;
+  Timer*& head = slots_[level][index];
+  if (timer->prevInSlot_)
+  {
+    timer->prevInSlot_->nextInSlot_ = timer->nextInSlot_;
+  }
+  else
+  {
+    assert(head == timer);
+    head = timer->nextInSlot_;
+  }
+  if (timer->nextInSlot_)
+  {
+    timer->nextInSlot_->prevInSlot_ = timer->prevInSlot_;
+  }
+  if (head == NULL)
+  {
+    occupied_[level][index / 64] &= ~(uint64_t(1) << (index % 64));
+  }
+  timer->prevInSlot_ = NULL;
+  timer->nextInSlot_ = NULL;
+  timer->slot_ = -1;
+  --counts_[level];
+  --size_;
+}
+
+// relinks timers of the current slot of the level, which go down,
+// @return the index of the slot
+int TimingWheel::cascade(int level)
+{
+  int index = static_cast<int>((current_ >> (kSlotBits * level)) & kMask);
+  if (counts_[level] == 0)
+  {
+    return index;
+  }
+  Timer* timer = slots_[level][index];
+  while (timer)
+  {
+    Timer* next = timer->nextInSlot_;
+    unlink(timer);
+    link(timer, tickOf(timer->expiration()));
+    timer = next;
+  }
+  return index;
+}
+
+// distance from slot 'from' to the first occupied slot, going round
+int TimingWheel::firstOccupied(int level, int from) const
+{
+  const uint64_t* bits = occupied_[level];
+  int first = from / 64;
+  for (int i = 0; i <= kWords; ++i)
+  {
+    int word = (first + i) % kWords;
+    uint64_t w = bits[word];
+    if (i == 0)
+    {
+      w &= ~uint64_t(0) << (from % 64);
+    }
+    else if (i == kWords)
+    {
+      // back to the first word, the slots before 'from'
+      w &= ~(~uint64_t(0) << (from % 64));
+    }
+    if (w)
+    {
+      int slot = word * 64 + __builtin_ctzll(w);
+      return (slot - from + kSlots) % kSlots;
+    }
+  }
+  assert(false);
+  return 0;
+}
@@ -0,0 +1,92 @@
+// 分层时间轮：O(1) 插入和删除的时间器存储
+
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_TIMINGWHEEL_H
+#define MUDUO_NET_TIMINGWHEEL_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Timestamp.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Timer;
+
+///
+/// Hierarchical timing wheel, the storage of TimerQueue when the loop
+/// uses EventLoop::setTimerWheel().
+///
+/// Time is cut into ticks, a timer expires at the first tick boundary at or
+/// after its expiration, so it runs up to one tick late, never early.
+/// Level 0 has one slot per tick, each of the higher levels has slots 256
+/// times as long.  When level 0 wraps, the next slot of level 1 cascades
+/// down, and so on.  Timers are linked into slots through Timer itself,
+/// add() and remove() are O(1) and don't allocate.
+///
+/// Timers farther than 2^32 ticks stay in the last level until they come
+/// near enough.
+///
+class TimingWheel : noncopyable
+{
+ public:
+  TimingWheel(Timestamp start, int64_t tickMicroSeconds);
+  ~TimingWheel();
+
+  /// @return true if the timer expires before all the others.
+  bool add(Timer* timer);
+  void remove(Timer* timer);
+
+  /// Moves out timers of all ticks that ended by @c now, in tick order.
+  void advance(Timestamp now, std::vector<Timer*>* expired);
+  /// Moves out all timers, in no particular order.
+  void takeAll(std::vector<Timer*>* timers);
+
+  /// The end of the earliest occupied tick, or a cascade, whichever is
+  /// first.  Invalid if empty.
+  Timestamp nextExpiration() const;
+
+  size_t size() const { return size_; }
+  int64_t tickMicroSeconds() const { return tick_; }
+
+ private:
+  static const int kLevels = 4;
+  static const int kSlotBits = 8;
+  static const int kSlots = 1 << kSlotBits;
+  static const int kMask = kSlots - 1;
+  static const int kWords = kSlots / 64;
+
+  // ticks are counted from start_
+  int64_t tickOf(Timestamp when) const;
+  Timestamp timeOf(int64_t tick) const;
+  int64_t nextTick() const;
+
+  void link(Timer* timer, int64_t expires);
+  void unlink(Timer* timer);
+  int cascade(int level);
+  int firstOccupied(int level, int from) const;
+
+  const int64_t start_;               // microseconds since epoch
+  const int64_t tick_;                // microseconds
+  int64_t current_;                   // the next tick to run
+  size_t size_;
+  size_t counts_[kLevels];            // 每层的时间器数量
+  Timer* slots_[kLevels][kSlots];     // 双向链表头
+  uint64_t occupied_[kLevels][kWords]; // 非空槽位的位图
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TIMINGWHEEL_H
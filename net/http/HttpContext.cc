@@ -8,6 +8,7 @@
 //
 
 #include "muduo/net/Buffer.h"
+#include "muduo/net/ByteScan.h"
 #include "muduo/net/http/HttpContext.h"
 
 using namespace muduo;
@@ -17,15 +18,15 @@ bool HttpContext::processRequestLine(const char* begin, const char* end)
 {
   bool succeed = false;
   const char* start = begin;
-  const char* space = std::find(start, end, ' ');
-  if (space != end && request_.setMethod(start, space))
+  const char* space = detail::findByte(start, end, ' ');
+  if (space && request_.setMethod(start, space))
   {
     start = space+1;
-    space = std::find(start, end, ' ');
-    if (space != end)
+    space = detail::findByte(start, end, ' ');
+    if (space)
     {
-      const char* question = std::find(start, space, '?');
-      if (question != space)
+      const char* question = detail::findByte(start, space, '?');
+      if (question)
       {
         request_.setPath(start, question);
         request_.setQuery(question, space);
@@ -56,6 +57,29 @@ bool HttpContext::processRequestLine(const char* begin, const char* end)
   return succeed;
 }
 
+// 从上次扫描结束的位置继续查找，数据分多次到达时每个字节只扫描一次
+const char* HttpContext::findCRLF(Buffer* buf)
+{
+  // someone else may have retrieved from buf in between, or it has moved
+  if (buf->peek() != scanFrom_ || buf->readableBytes() < scanned_)
+  {
+    scanned_ = 0;
+  }
+  const char* crlf = buf->findCRLF(buf->peek() + scanned_);
+  if (crlf)
+  {
+    scanFrom_ = NULL;
+    scanned_ = 0;
+  }
+  else if (buf->readableBytes() > 0)
+  {
+    // the last byte may be the '\r' of a CRLF split across reads
+    scanFrom_ = buf->peek();
+    scanned_ = buf->readableBytes() - 1;
+  }
+  return crlf;
+}
+
 // return false if any error
 bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
 {
@@ -65,7 +89,7 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
   {
     if (state_ == kExpectRequestLine)
     {
-      const char* crlf = buf->findCRLF();
+      const char* crlf = findCRLF(buf);
       if (crlf)
       {
         ok = processRequestLine(buf->peek(), crlf);
@@ -87,11 +111,11 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
     }
     else if (state_ == kExpectHeaders)
     {
-      const char* crlf = buf->findCRLF();
+      const char* crlf = findCRLF(buf);
       if (crlf)
       {
-        const char* colon = std::find(buf->peek(), crlf, ':');
-        if (colon != crlf)
+        const char* colon = detail::findByte(buf->peek(), crlf, ':');
+        if (colon)
         {
           request_.addHeader(buf->peek(), colon, crlf);
         }
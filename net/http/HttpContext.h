@@ -34,13 +34,16 @@ class HttpContext : public muduo::copyable
   };
 
   HttpContext()
-    : state_(kExpectRequestLine)
+    : state_(kExpectRequestLine),
+      scanFrom_(NULL),
+      scanned_(0)
   {
   }
 
   // default copy-ctor, dtor and assignment are fine
 
   // return false if any error
+  // call reset() if you retrieveAll() from buf and refill it in between
   bool parseRequest(Buffer* buf, Timestamp receiveTime);
 
   bool gotAll() const
@@ -49,6 +52,8 @@ class HttpContext : public muduo::copyable
   void reset()
   {
     state_ = kExpectRequestLine;
+    scanFrom_ = NULL;
+    scanned_ = 0;
     HttpRequest dummy;
     request_.swap(dummy);
   }
@@ -61,8 +66,14 @@ class HttpContext : public muduo::copyable
 
  private:
   bool processRequestLine(const char* begin, const char* end);
+  const char* findCRLF(Buffer* buf);
 
   HttpRequestParseState state_;
+  // bytes at scanFrom_ known to contain no CRLF, so that a line
+  // arriving in many pieces is scanned only once.
+  // Only used while buf->peek() is still scanFrom_.
+  const char* scanFrom_;
+  size_t scanned_;
   HttpRequest request_;
 };
 
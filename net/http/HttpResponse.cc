@@ -16,6 +16,12 @@ using namespace muduo;
 using namespace muduo::net;
 
 void HttpResponse::appendToBuffer(Buffer* output) const
+{
+  appendHeadersToBuffer(output);
+  output->append(body_);
+}
+
+void HttpResponse::appendHeadersToBuffer(Buffer* output) const
 {
   char buf[32];
   snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
@@ -43,5 +49,4 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
 
   output->append("\r\n");
-  output->append(body_);
 }
@@ -62,8 +62,14 @@ class HttpResponse : public muduo::copyable
   void setBody(const string& body)
   { body_ = body; }
 
+  const string& body() const
+  { return body_; }
+
   void appendToBuffer(Buffer* output) const;
 
+  // status line and headers only, the body can then be sent without copying
+  void appendHeadersToBuffer(Buffer* output) const;
+
  private:
   std::map<string, string> headers_;
   HttpStatusCode statusCode_;
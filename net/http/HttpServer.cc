@@ -90,8 +90,9 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
   HttpResponse response(close);
   httpCallback_(req, &response);
   Buffer buf;
-  response.appendToBuffer(&buf);
-  conn->send(&buf);
+  response.appendHeadersToBuffer(&buf);
+  conn->sendv({ StringPiece(buf.peek(), static_cast<int>(buf.readableBytes())),
+                response.body() });
   if (response.closeConnection())
   {
     conn->shutdown();
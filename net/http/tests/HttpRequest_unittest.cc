@@ -57,6 +57,27 @@ BOOST_AUTO_TEST_CASE(testParseRequestInTwoPieces)
   }
 }
 
+BOOST_AUTO_TEST_CASE(testParseRequestRetrievedInBetween)
+{
+  // the caller drops some junk before the request line arrives in full
+  string junk(20, 'x');
+  HttpContext context;
+  Buffer input;
+  input.append(junk + "GET /index.html");
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(!context.gotAll());
+
+  input.retrieve(junk.size());
+  input.append(" HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "\r\n");
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  const HttpRequest& request = context.request();
+  BOOST_CHECK_EQUAL(request.path(), string("/index.html"));
+  BOOST_CHECK_EQUAL(request.getHeader("Host"), string("www.chenshuo.com"));
+}
+
 BOOST_AUTO_TEST_CASE(testParseRequestEmptyHeaderValue)
 {
   HttpContext context;
@@ -9,18 +9,23 @@
 #include "muduo/net/Poller.h"
 #include "muduo/net/poller/PollPoller.h"
 #include "muduo/net/poller/EPollPoller.h"
+#include "muduo/net/poller/IoUringPoller.h"
 
 #include <stdlib.h>
 
 using namespace muduo::net;
 
-// 通过环境变量 选择使用 poll 或者 epoll
+// 通过环境变量 选择使用 poll、io_uring 或者 epoll
 Poller* Poller::newDefaultPoller(EventLoop* loop)
 {
   if (::getenv("MUDUO_USE_POLL"))
   {
     return new PollPoller(loop);
   }
+  else if (::getenv("MUDUO_USE_IO_URING") && IoUringPoller::isSupported())
+  {
+    return new IoUringPoller(loop);
+  }
   else
   {
     return new EPollPoller(loop);
@@ -66,7 +66,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
                                static_cast<int>(events_.size()),
                                timeoutMs);
   int savedErrno = errno;
-  Timestamp now(Timestamp::now());
+  Timestamp now(pollTime());
   if (numEvents > 0)
   {
     LOG_TRACE << numEvents << " events happened";
@@ -205,6 +205,10 @@ void EPollPoller::update(int operation, Channel* channel)
   struct epoll_event event;
   memZero(&event, sizeof event);
   event.events = channel->events();
+  if (channel->isEdgeTriggered())
+  {
+    event.events |= EPOLLET;
+  }
   event.data.ptr = channel;
   int fd = channel->fd();
   LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
@@ -0,0 +1,717 @@
+// user_data 的高 32 位是 fd，低 32 位是代数，channel 删除或修改后旧请求的完成事件被丢弃
+// 最高位为 1 的是 recv/sendmsg 操作，高 32 位是 operations_ 的下标
+
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/poller/IoUringPoller.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+const int kNew = -1;
+const int kAdded = 1;
+
+// completions of POLL_REMOVE itself carry this, fd 0 is tagged from 1
+const uint64_t kCancelTag = 0;
+const uint64_t kOperationBit = 1ULL << 63;
+const uint16_t kBufferGroup = 0;
+
+uint64_t makeUserData(int fd, uint32_t generation)
+{
+  return (static_cast<uint64_t>(fd) << 32) | generation;
+}
+
+uint64_t makeOperationId(uint32_t index, uint32_t generation)
+{
+  return kOperationBit | (static_cast<uint64_t>(index) << 32) | generation;
+}
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                   unsigned flags, const void* arg, size_t argSize)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                    minComplete, flags, arg, argSize));
+}
+
+int io_uring_register(int fd, unsigned opcode, void* arg, unsigned numArgs)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, numArgs));
+}
+
+int createRing(struct io_uring_params* params, unsigned sqEntries, unsigned cqEntries)
+{
+  // only the loop thread submits and reaps, completion work can wait
+  // until it calls io_uring_enter(2)
+  const unsigned kPreferred = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  memZero(params, sizeof *params);
+  params->flags = IORING_SETUP_CQSIZE | kPreferred;
+  params->cq_entries = cqEntries;
+  int fd = io_uring_setup(sqEntries, params);
+  if (fd < 0 && errno == EINVAL)
+  {
+    // before Linux 6.1
+    memZero(params, sizeof *params);
+    params->flags = IORING_SETUP_CQSIZE;
+    params->cq_entries = cqEntries;
+    fd = io_uring_setup(sqEntries, params);
+  }
+  return fd;
+}
+
+bool probeRing()
+{
+  struct io_uring_params params;
+  int fd = createRing(&params, 2, 4);
+  if (fd < 0)
+  {
+    return false;
+  }
+  ::close(fd);
+  // EXT_ARG: timeout without a timeout SQE, Linux 5.11
+  // RSRC_TAGS: Linux 5.13, which also brought multishot poll
+  const unsigned kRequired = IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP
+                           | IORING_FEAT_RSRC_TAGS;
+  return (params.features & kRequired) == kRequired;
+}
+
+}  // namespace
+
+const unsigned IoUringPoller::kSqEntries;
+const unsigned IoUringPoller::kCqEntries;
+const unsigned IoUringPoller::kNumBuffers;
+const unsigned IoUringPoller::kBufferSize;
+
+bool IoUringPoller::isSupported()
+{
+  static const bool supported = probeRing();
+  return supported;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+  : Poller(loop),
+    ringfd_(-1),
+    sqRing_(MAP_FAILED),
+    sqRingSize_(0),
+    cqRing_(MAP_FAILED),
+    cqRingSize_(0),
+    sqes_(NULL),
+    sqesSize_(0),
+    localTail_(0),
+    round_(0),
+    numActiveOperations_(0),
+    completionSupport_(-1),
+    bufferRing_(NULL),
+    bufferRingSize_(0)
+{
+  struct io_uring_params params;
+  ringfd_ = createRing(&params, kSqEntries, kCqEntries);
+  if (ringfd_ < 0)
+  {
+    LOG_SYSFATAL << "IoUringPoller::IoUringPoller - io_uring_setup";
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+  }
+  sqRing_ = ::mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED)
+  {
+    LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap sq ring";
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    cqRing_ = sqRing_;
+  }
+  else
+  {
+    cqRing_ = ::mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED)
+    {
+      LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap cq ring";
+    }
+  }
+  sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    LOG_SYSFATAL << "IoUringPoller::IoUringPoller - mmap sqes";
+  }
+  sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(sqRing_);
+  char* cq = static_cast<char*>(cqRing_);
+  sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqEntries_ = params.sq_entries;
+  sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+  localTail_ = *sqTail_;
+}
+
+IoUringPoller::~IoUringPoller()
+{
+  // a poll request holds a reference to its file, so a closed socket is
+  // not released until the request is gone.  Closing the ring cancels
+  // them asynchronously, cancel here so that e.g. a listening port can
+  // be bound again as soon as the loop is destroyed.
+  for (size_t fd = 0; fd < watches_.size(); ++fd)
+  {
+    if (watches_[fd].armed)
+    {
+      cancelPoll(static_cast<int>(fd), &watches_[fd]);
+    }
+  }
+  // a pending send reads, and a recv writes, memory we are about to free
+  for (size_t i = 0; i < operations_.size(); ++i)
+  {
+    if (operations_[i].active)
+    {
+      cancelOperation(makeOperationId(static_cast<uint32_t>(i), operations_[i].generation));
+    }
+  }
+  enter(0, 0);
+  ChannelList ignored;
+  for (int i = 0; numActiveOperations_ > 0 && i < 100; ++i)
+  {
+    enter(1, 10);
+    reapCompletions(&ignored);
+  }
+  retired_.clear();
+  if (sqes_)
+  {
+    ::munmap(sqes_, sqesSize_);
+  }
+  if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+  {
+    ::munmap(cqRing_, cqRingSize_);
+  }
+  if (sqRing_ != MAP_FAILED)
+  {
+    ::munmap(sqRing_, sqRingSize_);
+  }
+  // pending polls are cancelled when the ring is closed
+  ::close(ringfd_);
+  if (bufferRing_)
+  {
+    ::munmap(bufferRing_, bufferRingSize_);
+  }
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+  LOG_TRACE << "fd total count " << channels_.size();
+  ++round_;
+  retired_.clear();
+  syncWatches();
+  // 提交所有排队的请求，同时等待完成事件
+  int ret = enter(timeoutMs == 0 ? 0 : 1, timeoutMs);
+  int savedErrno = errno;
+  Timestamp now(pollTime());
+  if (ret < 0 && savedErrno != EINTR && savedErrno != ETIME && savedErrno != EBUSY)
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "IoUringPoller::poll()";
+  }
+  size_t numBefore = activeChannels->size();
+  reapCompletions(activeChannels);
+  if (activeChannels->size() > numBefore)
+  {
+    LOG_TRACE << activeChannels->size() - numBefore << " events happened";
+  }
+  else
+  {
+    LOG_TRACE << "nothing happened";
+  }
+  return now;
+}
+
+// 只记录，不做系统调用，下一次 poll() 时再提交
+void IoUringPoller::updateChannel(Channel* channel)
+{
+  Poller::assertInLoopThread();
+  const int index = channel->index();
+  const int fd = channel->fd();
+  LOG_TRACE << "fd = " << fd
+    << " events = " << channel->events() << " index = " << index;
+  if (index == kNew)
+  {
+    assert(channels_.find(fd) == channels_.end());
+    channels_[fd] = channel;
+    channel->set_index(kAdded);
+    Watch* watch = watchOf(fd);
+    watch->channel = channel;
+  }
+  else
+  {
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+    assert(index == kAdded);
+  }
+  markDirty(fd);
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+  Poller::assertInLoopThread();
+  const int fd = channel->fd();
+  LOG_TRACE << "fd = " << fd;
+  assert(channels_.find(fd) != channels_.end());
+  assert(channels_[fd] == channel);
+  assert(channel->isNoneEvent());
+  assert(channel->index() == kAdded);
+  size_t n = channels_.erase(fd);
+  (void)n;
+  assert(n == 1);
+
+  Watch* watch = watchOf(fd);
+  assert(watch->channel == channel);
+  watch->channel = NULL;
+  // the fd is usually closed right after, cancel now rather than in
+  // syncWatches(), so that a new channel on the same fd is not confused
+  if (watch->armed)
+  {
+    cancelPoll(fd, watch);
+  }
+  channel->set_index(kNew);
+}
+
+IoUringPoller::Watch* IoUringPoller::watchOf(int fd)
+{
+  assert(fd >= 0);
+  if (implicit_cast<size_t>(fd) >= watches_.size())
+  {
+    watches_.resize(fd + 1);
+  }
+  return &watches_[fd];
+}
+
+void IoUringPoller::markDirty(int fd)
+{
+  Watch* watch = watchOf(fd);
+  if (!watch->dirty)
+  {
+    watch->dirty = true;
+    dirtyFds_.push_back(fd);
+  }
+}
+
+// 把 channel 的兴趣和已提交的 poll 请求对齐
+void IoUringPoller::syncWatches()
+{
+  for (int fd : dirtyFds_)
+  {
+    Watch* watch = &watches_[fd];
+    watch->dirty = false;
+    const Channel* channel = watch->channel;
+    const int events = channel ? channel->events() : 0;
+    const bool multishot = channel && channel->isEdgeTriggered();
+    if (watch->armed
+        && (watch->armedEvents != events || watch->multishot != multishot))
+    {
+      cancelPoll(fd, watch);
+    }
+    if (!watch->armed && events != 0)
+    {
+      watch->armedEvents = events;
+      watch->multishot = multishot;
+      armPoll(fd, watch);
+    }
+  }
+  dirtyFds_.clear();
+}
+
+void IoUringPoller::armPoll(int fd, Watch* watch)
+{
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = static_cast<uint32_t>(watch->armedEvents);
+  sqe->len = watch->multishot ? IORING_POLL_ADD_MULTI : 0;
+  sqe->user_data = makeUserData(fd, ++watch->generation);
+  watch->armed = true;
+  LOG_TRACE << "POLL_ADD fd = " << fd << " events = " << watch->armedEvents
+    << (watch->multishot ? " multishot" : "");
+}
+
+void IoUringPoller::cancelPoll(int fd, Watch* watch)
+{
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = makeUserData(fd, watch->generation);
+  sqe->user_data = kCancelTag;
+  // the cancelled request completes with -ECANCELED, which no longer
+  // matches the generation
+  ++watch->generation;
+  watch->armed = false;
+  LOG_TRACE << "POLL_REMOVE fd = " << fd;
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+  unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (localTail_ - head >= sqEntries_)
+  {
+    // SQ 满了，先提交一批，不等待
+    enter(0, 0);
+    head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (localTail_ - head >= sqEntries_)
+    {
+      LOG_FATAL << "IoUringPoller::getSqe - submission queue stuck";
+    }
+  }
+  unsigned index = localTail_ & sqMask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memZero(sqe, sizeof *sqe);
+  sqArray_[index] = index;
+  ++localTail_;
+  return sqe;
+}
+
+int IoUringPoller::enter(unsigned minComplete, int timeoutMs)
+{
+  __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+  unsigned toSubmit = localTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  memZero(&arg, sizeof arg);
+  if (timeoutMs >= 0)
+  {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+  int ret;
+  do
+  {
+    ret = io_uring_enter(ringfd_, toSubmit, minComplete,
+                         IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                         &arg, sizeof arg);
+    // a signal before anything was submitted, don't lose the batch
+  } while (ret < 0 && errno == EINTR && minComplete == 0);
+  return ret;
+}
+
+void IoUringPoller::reapCompletions(ChannelList* activeChannels)
+{
+  unsigned head = *cqHead_;
+  const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head)
+  {
+    const struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+    const uint64_t userData = cqe->user_data;
+    if (userData == kCancelTag)
+    {
+      continue;
+    }
+    if (userData & kOperationBit)
+    {
+      completeOperation(userData, cqe, activeChannels);
+      continue;
+    }
+    const int fd = static_cast<int>(userData >> 32);
+    const uint32_t generation = static_cast<uint32_t>(userData);
+    assert(implicit_cast<size_t>(fd) < watches_.size());
+    Watch* watch = &watches_[fd];
+    if (!watch->armed || watch->generation != generation)
+    {
+      // 已经被取消或者替换的请求
+      continue;
+    }
+
+    int revents = cqe->res;
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+      // one-shot, or the kernel ended a multishot poll, arm it again
+      watch->armed = false;
+      markDirty(fd);
+    }
+    if (revents == -ECANCELED)
+    {
+      continue;
+    }
+    else if (revents < 0)
+    {
+      LOG_ERROR << "IoUringPoller POLL_ADD fd = " << fd << " error " << -revents;
+      revents = POLLNVAL;
+      // don't spin on a bad fd, wait for the owner to update it
+      watch->dirty = false;
+      dirtyFds_.erase(std::remove(dirtyFds_.begin(), dirtyFds_.end(), fd),
+                      dirtyFds_.end());
+    }
+
+    assert(watch->channel != NULL);
+    activate(watch->channel, revents, activeChannels);
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::activate(Channel* channel, int revents, ChannelList* activeChannels)
+{
+  Watch* watch = watchOf(channel->fd());
+  if (watch->activeRound == round_)
+  {
+    // several completions of a multishot poll or operation in one batch
+    channel->set_revents(channel->revents() | revents);
+  }
+  else
+  {
+    watch->activeRound = round_;
+    channel->set_revents(revents);
+    activeChannels->push_back(channel);
+  }
+}
+
+IoUringPoller::OperationId IoUringPoller::startOperation(Channel* channel,
+                                                         CompletionCallback cb,
+                                                         struct io_uring_sqe** sqe)
+{
+  uint32_t index;
+  if (freeOperations_.empty())
+  {
+    index = static_cast<uint32_t>(operations_.size());
+    operations_.emplace_back();
+  }
+  else
+  {
+    index = freeOperations_.back();
+    freeOperations_.pop_back();
+  }
+  Operation& op = operations_[index];
+  assert(!op.active);
+  op.channel = channel;
+  op.callback = std::move(cb);
+  op.active = true;
+  ++numActiveOperations_;
+  OperationId id = makeOperationId(index, ++op.generation);
+  *sqe = getSqe();
+  (*sqe)->user_data = id;
+  return id;
+}
+
+void IoUringPoller::completeOperation(uint64_t userData, const struct io_uring_cqe* cqe,
+                                      ChannelList* activeChannels)
+{
+  const uint32_t index = static_cast<uint32_t>((userData & ~kOperationBit) >> 32);
+  assert(index < operations_.size());
+  Operation& op = operations_[index];
+  if (!op.active || op.generation != static_cast<uint32_t>(userData))
+  {
+    return;
+  }
+  const bool last = !(cqe->flags & IORING_CQE_F_MORE);
+  // the callback may start operations, op stays put in the deque
+  int revents = op.callback(cqe->res, cqe->flags);
+  if (revents != 0 && op.channel != NULL)
+  {
+    activate(op.channel, revents, activeChannels);
+  }
+  if (last)
+  {
+    retired_.push_back(std::move(op.callback));
+    op.callback = CompletionCallback();
+    op.channel = NULL;
+    op.active = false;
+    --numActiveOperations_;
+    freeOperations_.push_back(index);
+  }
+}
+
+IoUringPoller::OperationId IoUringPoller::recvMultishot(Channel* channel, CompletionCallback cb)
+{
+  assert(completionSupport_ != 0);
+  return startRecv(channel->fd(), channel, std::move(cb));
+}
+
+IoUringPoller::OperationId IoUringPoller::startRecv(int fd, Channel* channel, CompletionCallback cb)
+{
+  struct io_uring_sqe* sqe = NULL;
+  OperationId id = startOperation(channel, std::move(cb), &sqe);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  return id;
+}
+
+IoUringPoller::OperationId IoUringPoller::sendmsg(Channel* channel,
+                                                  const struct msghdr* msg,
+                                                  CompletionCallback cb)
+{
+  struct io_uring_sqe* sqe = NULL;
+  OperationId id = startOperation(channel, std::move(cb), &sqe);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = channel->fd();
+  sqe->addr = reinterpret_cast<uint64_t>(msg);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  return id;
+}
+
+void IoUringPoller::cancelOperation(OperationId id)
+{
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = id;
+  sqe->user_data = kCancelTag;
+}
+
+const char* IoUringPoller::providedBuffer(unsigned flags) const
+{
+  assert(flags & IORING_CQE_F_BUFFER);
+  unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+  assert(bid < kNumBuffers);
+  return &buffers_[bid * kBufferSize];
+}
+
+void IoUringPoller::recycleBuffer(unsigned flags)
+{
+  if (!(flags & IORING_CQE_F_BUFFER))
+  {
+    return;
+  }
+  unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+  uint16_t tail = bufferRing_->tail;
+  // the ring is an array of io_uring_buf, the tail overlays resv of the
+  // first one.  Don't use bufs[], in C++ the header puts it at offset 8.
+  struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufferRing_)
+                             + (tail & (kNumBuffers - 1));
+  buf->addr = reinterpret_cast<uint64_t>(&buffers_[bid * kBufferSize]);
+  buf->len = kBufferSize;
+  buf->bid = static_cast<uint16_t>(bid);
+  __atomic_store_n(&bufferRing_->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+bool IoUringPoller::supportsCompletions()
+{
+  if (completionSupport_ < 0)
+  {
+    // probe on a ring of its own, its completions must not mix with ours
+    static const bool recvMultishot = probeRecvMultishot();
+    completionSupport_ = recvMultishot && setupBuffers() ? 1 : 0;
+    if (!completionSupport_)
+    {
+      LOG_WARN << "IoUringPoller - no provided buffer ring or multishot recv, "
+                  "completion mode is off";
+    }
+  }
+  return completionSupport_ == 1;
+}
+
+// 注册一组缓冲区，multishot recv 每次完成时由内核从中挑选一个
+bool IoUringPoller::setupBuffers()
+{
+  static_assert((kNumBuffers & (kNumBuffers - 1)) == 0, "ring size must be a power of 2");
+  bufferRingSize_ = kNumBuffers * sizeof(struct io_uring_buf);
+  void* ring = ::mmap(NULL, bufferRingSize_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (ring == MAP_FAILED)
+  {
+    LOG_SYSERR << "IoUringPoller::setupBuffers - mmap";
+    return false;
+  }
+  bufferRing_ = static_cast<struct io_uring_buf_ring*>(ring);
+
+  struct io_uring_buf_reg reg;
+  memZero(&reg, sizeof reg);
+  reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+  reg.ring_entries = kNumBuffers;
+  reg.bgid = kBufferGroup;
+  // Linux 5.19
+  if (io_uring_register(ringfd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+  {
+    LOG_SYSERR << "IoUringPoller::setupBuffers - IORING_REGISTER_PBUF_RING";
+    ::munmap(bufferRing_, bufferRingSize_);
+    bufferRing_ = NULL;
+    return false;
+  }
+  buffers_.resize(kNumBuffers * kBufferSize);
+  bufferRing_->tail = 0;
+  for (unsigned bid = 0; bid < kNumBuffers; ++bid)
+  {
+    recycleBuffer((bid << IORING_CQE_BUFFER_SHIFT) | IORING_CQE_F_BUFFER);
+  }
+  return true;
+}
+
+// multishot recv is Linux 6.0, one later than the buffer ring,
+// try it once on a socketpair
+bool IoUringPoller::probeRecvMultishot()
+{
+  // never polls channels, so it needs no loop
+  IoUringPoller ring(NULL);
+  return ring.setupBuffers() && ring.tryRecvMultishot();
+}
+
+bool IoUringPoller::tryRecvMultishot()
+{
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+  {
+    return false;
+  }
+  int result = -EINVAL;
+  bool more = false;
+  OperationId id = startRecv(fds[0], NULL, [this, &result, &more](int res, unsigned flags) {
+    result = res;
+    more = more || (flags & IORING_CQE_F_MORE);
+    recycleBuffer(flags);
+    return 0;
+  });
+  ssize_t n = ::write(fds[1], "x", 1);
+  (void)n;
+  ChannelList ignored;
+  enter(1, 1000);
+  reapCompletions(&ignored);
+  const bool ok = result == 1 && more;
+  cancelOperation(id);
+  for (int i = 0; numActiveOperations_ > 0 && i < 100; ++i)
+  {
+    enter(1, 10);
+    reapCompletions(&ignored);
+  }
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return ok;
+}
@@ -0,0 +1,175 @@
+// io_uring 实现，用 IORING_OP_POLL_ADD 等待就绪事件
+// 兴趣的增删改只是写入 SQ，在 poll() 中和等待一起用一次 io_uring_enter 提交
+
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_POLLER_IOURINGPOLLER_H
+#define MUDUO_NET_POLLER_IOURINGPOLLER_H
+
+#include "muduo/net/Poller.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+struct msghdr;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// IO Multiplexing with io_uring(7) poll requests.
+///
+/// Channel::update() only records the channel, changes of interest are
+/// queued as POLL_ADD / POLL_REMOVE entries and submitted in poll(),
+/// together with the wait, in a single io_uring_enter(2).
+///
+/// Edge-triggered channels use a multishot poll, which stays armed.
+/// The others use a one-shot poll which is armed again in the next poll(),
+/// after the channel has handled its events, so they are level-triggered
+/// as with epoll.
+///
+/// The kernel holds a reference to the file of a pending poll, so the
+/// fd of a removed channel is released when the next poll() submits the
+/// cancellation, at the end of the current loop iteration.
+///
+/// Besides readiness, it runs recv and sendmsg operations for the
+/// completion mode of TcpConnection.  Received data lands in buffers the
+/// poller provides to the kernel, one group shared by all connections.
+///
+class IoUringPoller : public Poller
+{
+ public:
+  /// Handles one completion of an operation.  Runs inside poll(), so it
+  /// must not call back into user code.
+  /// @return events to report on the operation's channel, 0 for none.
+  typedef std::function<int (int res, unsigned flags)> CompletionCallback;
+  typedef uint64_t OperationId;   // 0 is none
+
+  static const unsigned kNumBuffers = 256;
+  static const unsigned kBufferSize = 8*1024;
+
+  IoUringPoller(EventLoop* loop);
+  ~IoUringPoller() override;
+
+  Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+  void updateChannel(Channel* channel) override;
+  void removeChannel(Channel* channel) override;
+
+  /// Whether the running kernel provides what this poller needs.
+  static bool isSupported();
+
+  /// Sets up provided buffers on first call, checks multishot recv works.
+  bool supportsCompletions();
+
+  /// Receives into provided buffers, one completion per read, until it is
+  /// cancelled, fails, or the peer closes.  The callback is kept until
+  /// the last completion, i.e. the one without IORING_CQE_F_MORE.
+  OperationId recvMultishot(Channel* channel, CompletionCallback cb);
+
+  /// @c msg and the data it points to must stay valid until completion.
+  OperationId sendmsg(Channel* channel, const struct msghdr* msg, CompletionCallback cb);
+
+  /// The operation completes with -ECANCELED unless it is done already.
+  void cancelOperation(OperationId id);
+
+  /// Data of a recv completion with IORING_CQE_F_BUFFER in @c flags.
+  const char* providedBuffer(unsigned flags) const;
+  /// Gives the buffer of a recv completion back to the kernel.
+  void recycleBuffer(unsigned flags);
+
+ private:
+  static const unsigned kSqEntries = 256;
+  static const unsigned kCqEntries = 4096;
+
+  struct Operation
+  {
+    Channel* channel = nullptr;   // may be NULL
+    CompletionCallback callback;
+    uint32_t generation = 0;
+    bool active = false;
+  };
+
+  // poll request state of one fd
+  struct Watch
+  {
+    Channel* channel = nullptr;
+    uint32_t generation = 0;    // tags user_data, to drop stale completions
+    int armedEvents = 0;
+    bool armed = false;
+    bool multishot = false;
+    bool dirty = false;
+    uint64_t activeRound = 0;
+  };
+
+  Watch* watchOf(int fd);
+  void markDirty(int fd);
+  void syncWatches();
+  void armPoll(int fd, Watch* watch);
+  void cancelPoll(int fd, Watch* watch);
+  struct io_uring_sqe* getSqe();
+  int enter(unsigned minComplete, int timeoutMs);
+  void reapCompletions(ChannelList* activeChannels);
+  void activate(Channel* channel, int revents, ChannelList* activeChannels);
+  OperationId startOperation(Channel* channel, CompletionCallback cb, struct io_uring_sqe** sqe);
+  OperationId startRecv(int fd, Channel* channel, CompletionCallback cb);
+  void completeOperation(uint64_t userData, const struct io_uring_cqe* cqe,
+                         ChannelList* activeChannels);
+  bool setupBuffers();
+  static bool probeRecvMultishot();
+  bool tryRecvMultishot();
+
+  int ringfd_;
+  void* sqRing_;
+  size_t sqRingSize_;
+  void* cqRing_;
+  size_t cqRingSize_;
+  struct io_uring_sqe* sqes_;
+  size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned* sqArray_;
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  struct io_uring_cqe* cqes_;
+
+  unsigned localTail_;          // entries queued but not yet published
+  std::vector<Watch> watches_;  // indexed by fd
+  std::vector<int> dirtyFds_;
+  uint64_t round_;
+
+  std::deque<Operation> operations_;    // elements never move
+  std::vector<uint32_t> freeOperations_;
+  size_t numActiveOperations_;
+  // finished callbacks may own the channel they just reported,
+  // keep them until the events are handled
+  std::vector<CompletionCallback> retired_;
+
+  int completionSupport_;   // -1 unknown, 0 no, 1 yes
+  struct io_uring_buf_ring* bufferRing_;
+  size_t bufferRingSize_;
+  std::vector<char> buffers_;
+};
+
+}  // namespace net
+}  // namespace muduo
+#endif  // MUDUO_NET_POLLER_IOURINGPOLLER_H
@@ -32,7 +32,7 @@ Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels)
   // XXX pollfds_ shouldn't change
   int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
   int savedErrno = errno;
-  Timestamp now(Timestamp::now());
+  Timestamp now(pollTime());
   if (numEvents > 0)
   {
     LOG_TRACE << numEvents << " events happened";
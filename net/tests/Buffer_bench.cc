@@ -0,0 +1,97 @@
+// Buffer::readFd 吞吐量测试：对比 64KiB 栈缓冲区（两次拷贝）与内存池直接读取
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/BufferPool.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kChunk = 256*1024;
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+void writer(int fd, int64_t total)
+{
+  std::vector<char> chunk(kChunk, 'x');
+  while (total > 0)
+  {
+    size_t len = std::min(kChunk, static_cast<size_t>(total));
+    ssize_t n = ::write(fd, chunk.data(), len);
+    if (n <= 0)
+    {
+      break;
+    }
+    total -= n;
+  }
+}
+
+void bench(const char* name, BufferPool* pool, int64_t total)
+{
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+  {
+    perror("socketpair");
+    abort();
+  }
+  int sndbuf = 4*1024*1024;
+  ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+
+  Thread thr(std::bind(writer, fds[0], total), "writer");
+  thr.start();
+
+  Buffer buf;
+  if (pool)
+  {
+    buf.setPool(pool);
+  }
+  int64_t received = 0;
+  int64_t reads = 0;
+  Timestamp start(Timestamp::now());
+  double cpuStart = threadCpuSeconds();
+  while (received < total)
+  {
+    int savedErrno = 0;
+    ssize_t n = buf.readFd(fds[1], &savedErrno);
+    if (n <= 0)
+    {
+      break;
+    }
+    received += n;
+    ++reads;
+    // like TcpConnection::handleRead, consume then give storage back
+    buf.retrieveAll();
+    buf.releaseToPool();
+  }
+  double cpu = threadCpuSeconds() - cpuStart;
+  double seconds = timeDifference(Timestamp::now(), start);
+  thr.join();
+  ::close(fds[0]);
+  ::close(fds[1]);
+
+  double mib = static_cast<double>(received) / (1024*1024);
+  printf("%-10s %8.1f MiB/s %8.1f MiB/cpu-sec %8.1f KiB/read\n",
+         name, mib / seconds, mib / cpu, mib * 1024 / static_cast<double>(reads));
+}
+
+int main(int argc, char* argv[])
+{
+  int64_t total = static_cast<int64_t>(argc > 1 ? atoi(argv[1]) : 2048) * 1024 * 1024;
+  BufferPool pool;
+  bench("extrabuf", NULL, total);
+  bench("in-place", &pool, total);
+  bench("extrabuf", NULL, total);
+  bench("in-place", &pool, total);
+}
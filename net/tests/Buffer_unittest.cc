@@ -1,6 +1,7 @@
 // check 缓冲区
 
 #include "muduo/net/Buffer.h"
+#include "muduo/net/BufferPool.h"
 
 //#define BOOST_TEST_MODULE BufferTest
 #define BOOST_TEST_MAIN
@@ -9,6 +10,7 @@
 
 using muduo::string;
 using muduo::net::Buffer;
+using muduo::net::BufferPool;
 
 BOOST_AUTO_TEST_CASE(testBufferAppendRetrieve)
 {
@@ -171,3 +173,111 @@ BOOST_AUTO_TEST_CASE(testMove)
   // printf("Buffer at %p, inner %p\n", &buf, inner);
   output(std::move(buf), inner);
 }
+
+BOOST_AUTO_TEST_CASE(testBufferPool)
+{
+  BufferPool pool;
+  Buffer buf;
+  buf.setPool(&pool);
+  BOOST_CHECK_EQUAL(buf.internalCapacity(), 0);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 0);
+
+  buf.append(string(200, 'x'));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 200);
+  BOOST_CHECK_EQUAL(buf.prependableBytes(), Buffer::kCheapPrepend);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), BufferPool::kMinBlockSize);
+
+  // not empty, keeps its storage
+  buf.releaseToPool();
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), BufferPool::kMinBlockSize);
+
+  // grows by borrowing a larger block
+  buf.append(string(2000, 'y'));
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 4*BufferPool::kMinBlockSize);
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), BufferPool::kMinBlockSize);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(200, 'x') + string(2000, 'y'));
+
+  buf.releaseToPool();
+  BOOST_CHECK_EQUAL(buf.internalCapacity(), 0);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.writableBytes(), 0);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 0);
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), 5*BufferPool::kMinBlockSize);
+
+  int x = 0;
+  buf.prepend(&x, sizeof x);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), sizeof x);
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), 4*BufferPool::kMinBlockSize);
+
+  pool.shrink();
+  BOOST_CHECK_EQUAL(pool.pooledBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferPoolMoveSwap)
+{
+  BufferPool pool;
+  {
+  Buffer pooled;
+  pooled.setPool(&pool);
+  pooled.append(string(200, 'x'));
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), BufferPool::kMinBlockSize);
+
+  // the new Buffer has no pool, the storage is no longer borrowed
+  Buffer moved(std::move(pooled));
+  BOOST_CHECK(moved.pool() == NULL);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 0);
+
+  // adopted by the pool of the Buffer assigned to
+  pooled = std::move(moved);
+  BOOST_CHECK(pooled.pool() == &pool);
+  BOOST_CHECK_EQUAL(pooled.readableBytes(), 200);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), pooled.internalCapacity());
+
+  // the old storage goes back to the pool
+  Buffer copy(pooled);
+  copy.retrieve(100);
+  pooled = copy;
+  BOOST_CHECK_EQUAL(pooled.readableBytes(), 100);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), pooled.internalCapacity());
+
+  Buffer unpooled;
+  unpooled.append("muduo", 5);
+  pooled.swap(unpooled);
+  BOOST_CHECK(unpooled.pool() == &pool);
+  BOOST_CHECK(pooled.pool() == NULL);
+  BOOST_CHECK_EQUAL(unpooled.readableBytes(), 100);
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), unpooled.internalCapacity());
+  }
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testTakeStorage)
+{
+  BufferPool pool;
+  Buffer buf;
+  buf.setPool(&pool);
+  buf.append("muduo net", 9);
+  buf.retrieve(6);
+  const char* data = buf.peek();
+  size_t begin = 0;
+  size_t end = 0;
+  std::vector<char> storage = buf.takeStorage(&begin, &end);
+  // no copy, and no longer borrowed from the pool
+  BOOST_CHECK(storage.data() + begin == data);
+  BOOST_CHECK_EQUAL(string(storage.data() + begin, end - begin), "net");
+  BOOST_CHECK_EQUAL(pool.inUseBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  buf.append("muduo", 5);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "muduo");
+}
+
+BOOST_AUTO_TEST_CASE(testMovedFrom)
+{
+  Buffer buf;
+  buf.append("muduo", 5);
+  Buffer other(std::move(buf));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  buf.append("net", 3);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "net");
+  BOOST_CHECK_EQUAL(other.retrieveAllAsString(), "muduo");
+}
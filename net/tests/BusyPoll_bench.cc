@@ -0,0 +1,169 @@
+// 忙轮询模式的延迟：跨线程 runInLoop 从投递到执行，以及 1 字节 TCP 往返
+
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 23459;
+
+int64_t nowNanos()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// the loop goes idle between samples, as a lightly loaded gateway does
+void pause(int idleMicroSeconds)
+{
+  if (idleMicroSeconds > 0)
+  {
+    ::usleep(idleMicroSeconds);
+  }
+}
+
+void report(const char* name, std::vector<int64_t>* samples, EventLoop* loop)
+{
+  std::sort(samples->begin(), samples->end());
+  size_t n = samples->size();
+  printf("%-28s p50 %7.1f us  p99 %7.1f us  spins %ld hits %ld misses %ld\n",
+         name,
+         static_cast<double>((*samples)[n / 2]) / 1000,
+         static_cast<double>((*samples)[n * 99 / 100]) / 1000,
+         static_cast<long>(loop->busyPollSpins()),
+         static_cast<long>(loop->busyPollHits()),
+         static_cast<long>(loop->busyPollMisses()));
+}
+
+// 从 queueInLoop 到回调开始执行
+void wakeLatency(int64_t spinMicroSeconds, int numSamples, int idleMicroSeconds)
+{
+  EventLoopThread thread([spinMicroSeconds](EventLoop* loop) {
+    loop->setBusyPoll(spinMicroSeconds);
+  });
+  EventLoop* loop = thread.startLoop();
+
+  std::vector<int64_t> samples;
+  samples.reserve(numSamples);
+  std::atomic<int64_t> latency(0);
+  for (int i = 0; i < numSamples; ++i)
+  {
+    pause(idleMicroSeconds);
+    int64_t start = nowNanos();
+    loop->queueInLoop([start, &latency] {
+      latency.store(nowNanos() - start, std::memory_order_release);
+    });
+    int64_t ns = 0;
+    while ((ns = latency.exchange(0, std::memory_order_acquire)) == 0)
+    {
+    }
+    samples.push_back(ns);
+  }
+  char name[64];
+  snprintf(name, sizeof name, "wake spin=%ldus", static_cast<long>(spinMicroSeconds));
+  report(name, &samples, loop);
+}
+
+// 1 字节回显，客户端使用阻塞 socket
+void roundTrip(int64_t spinMicroSeconds, int socketMicroSeconds,
+               int numSamples, int idleMicroSeconds)
+{
+  EventLoopThread thread([=](EventLoop* loop) {
+    loop->setBusyPoll(spinMicroSeconds, socketMicroSeconds);
+  });
+  EventLoop* loop = thread.startLoop();
+  InetAddress listenAddr(kPort, true);
+  std::unique_ptr<TcpServer> server;
+  CountDownLatch started(1);
+  loop->runInLoop([&] {
+    server.reset(new TcpServer(loop, listenAddr, "BusyPollServer"));
+    server->setConnectionCallback([](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+      }
+    });
+    server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+      conn->send(buf);
+    });
+    server->start();
+    started.countDown();
+  });
+  started.wait();
+
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0)
+  {
+    perror("connect");
+    abort();
+  }
+  int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+  std::vector<int64_t> samples;
+  samples.reserve(numSamples);
+  for (int i = 0; i < numSamples; ++i)
+  {
+    pause(idleMicroSeconds);
+    char c = 'x';
+    int64_t start = nowNanos();
+    if (::write(fd, &c, 1) != 1 || ::read(fd, &c, 1) != 1)
+    {
+      perror("echo");
+      abort();
+    }
+    samples.push_back(nowNanos() - start);
+  }
+  // the server closes first
+  CountDownLatch stopped(1);
+  loop->runInLoop([&] {
+    server.reset();
+    stopped.countDown();
+  });
+  stopped.wait();
+  ::close(fd);
+
+  char name[64];
+  snprintf(name, sizeof name, "rtt spin=%ldus so=%dus",
+           static_cast<long>(spinMicroSeconds), socketMicroSeconds);
+  report(name, &samples, loop);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  int64_t spin = argc > 1 ? atoll(argv[1]) : 1000;
+  int socketBusyPoll = argc > 2 ? atoi(argv[2]) : 0;
+  int numSamples = argc > 3 ? atoi(argv[3]) : 10000;
+  int idle = argc > 4 ? atoi(argv[4]) : 20;
+  Logger::setLogLevel(Logger::WARN);
+
+  wakeLatency(0, numSamples, idle);
+  wakeLatency(spin, numSamples, idle);
+  roundTrip(0, 0, numSamples, idle);
+  roundTrip(spin, socketBusyPoll, numSamples, idle);
+}
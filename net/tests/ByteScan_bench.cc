@@ -0,0 +1,106 @@
+// 比较 std::search / memchr（原实现）与 SSE2 / AVX2 扫描 HTTP 头部的速度
+
+#include "muduo/net/ByteScan.h"
+#include "muduo/base/Timestamp.h"
+
+#include <algorithm>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const char kCRLF[] = "\r\n";
+
+const char* searchCRLF(const char* begin, const char* end)
+{
+  // what Buffer::findCRLF used to do
+  const char* crlf = std::search(begin, end, kCRLF, kCRLF+2);
+  return crlf == end ? NULL : crlf;
+}
+
+const char* memchrLF(const char* begin, const char* end, char c)
+{
+  return static_cast<const char*>(::memchr(begin, c, end - begin));
+}
+
+// a typical browser request, ~600 bytes
+const char kRequest[] =
+  "GET /static/js/app.4f2a9c.js?v=20200131 HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "Connection: keep-alive\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+  "(KHTML, like Gecko) Chrome/80.0.3987.100 Safari/537.36\r\n"
+  "Accept: */*\r\n"
+  "Sec-Fetch-Site: same-origin\r\n"
+  "Sec-Fetch-Mode: no-cors\r\n"
+  "Referer: https://www.example.com/index.html\r\n"
+  "Accept-Encoding: gzip, deflate, br\r\n"
+  "Accept-Language: en-US,en;q=0.9,zh-CN;q=0.8,zh;q=0.7\r\n"
+  "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; "
+  "_ga=GA1.2.1234567890.1580000000; _gid=GA1.2.987654321.1580000000\r\n"
+  "\r\n";
+
+const int kRounds = 200000;
+
+// split every line, the way HttpContext::parseRequest does
+void benchLines(const char* name, detail::FindCRLFFunc findCRLF, detail::FindByteFunc findByte)
+{
+  const char* end = kRequest + sizeof kRequest - 1;
+  size_t lines = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < kRounds; ++i)
+  {
+    const char* p = kRequest;
+    while (const char* crlf = findCRLF(p, end))
+    {
+      lines += findByte(p, crlf, ':') != NULL;
+      p = crlf + 2;
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  double bytes = static_cast<double>(sizeof kRequest - 1) * kRounds;
+  printf("%-14s %8.1f MiB/s %8.1f ns/request (%zd)\n",
+         name, bytes / seconds / (1024*1024), seconds * 1e9 / kRounds, lines);
+}
+
+// a large body without CRLF, e.g. scanning a long line or a POST body
+void benchLong(const char* name, detail::FindCRLFFunc findCRLF)
+{
+  std::string body(64*1024, 'x');
+  body += "\r\n";
+  const int rounds = 20000;
+  size_t found = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < rounds; ++i)
+  {
+    found += findCRLF(body.data(), body.data() + body.size()) != NULL;
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  double bytes = static_cast<double>(body.size()) * rounds;
+  printf("%-14s %8.1f MiB/s 64KiB line (%zd)\n",
+         name, bytes / seconds / (1024*1024), found);
+}
+
+}  // namespace
+
+int main()
+{
+  printf("dispatched kernel: %s\n", detail::scanKernelName());
+  benchLines("std::search", searchCRLF, memchrLF);
+  benchLines("scalar", detail::findCRLFScalar, detail::findByteScalar);
+  benchLines("sse2", detail::findCRLFSse2, detail::findByteSse2);
+  benchLines("avx2", detail::findCRLFAvx2, detail::findByteAvx2);
+  benchLines("dispatched", detail::findCRLF, detail::findByte);
+
+  benchLong("std::search", searchCRLF);
+  benchLong("scalar", detail::findCRLFScalar);
+  benchLong("sse2", detail::findCRLFSse2);
+  benchLong("avx2", detail::findCRLFAvx2);
+  benchLong("dispatched", detail::findCRLF);
+}
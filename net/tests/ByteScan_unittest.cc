@@ -0,0 +1,108 @@
+#include "muduo/net/ByteScan.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <stdlib.h>
+
+using std::string;
+using namespace muduo::net;
+
+namespace
+{
+
+const char kCRLF[] = "\r\n";
+
+const char* referenceCRLF(const char* begin, const char* end)
+{
+  const char* crlf = std::search(begin, end, kCRLF, kCRLF+2);
+  return crlf == end ? NULL : crlf;
+}
+
+const char* referenceByte(const char* begin, const char* end, char c)
+{
+  const char* p = std::find(begin, end, c);
+  return p == end ? NULL : p;
+}
+
+// mostly letters, with some '\r', '\n' and ':'
+string randomText(size_t len)
+{
+  const char alphabet[] = "abcdefgh\r\n:";
+  string text(len, 'x');
+  for (size_t i = 0; i < len; ++i)
+  {
+    text[i] = (rand() % 8 == 0) ? alphabet[rand() % 11] : 'x';
+  }
+  return text;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testFindCRLF)
+{
+  detail::FindCRLFFunc kernels[] =
+  {
+    detail::findCRLFScalar, detail::findCRLFSse2,
+    detail::findCRLFAvx2, detail::findCRLF,
+  };
+  srand(42);
+  for (int i = 0; i < 2000; ++i)
+  {
+    string text = randomText(rand() % 200);
+    for (size_t offset = 0; offset < std::min<size_t>(text.size(), 3); ++offset)
+    {
+      const char* begin = text.data() + offset;
+      const char* end = text.data() + text.size();
+      for (detail::FindCRLFFunc find : kernels)
+      {
+        BOOST_CHECK_EQUAL(static_cast<const void*>(find(begin, end)),
+                          static_cast<const void*>(referenceCRLF(begin, end)));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testFindCRLFAtBoundary)
+{
+  // '\r' as the last byte of a 16/32-byte block
+  for (size_t pos = 0; pos < 70; ++pos)
+  {
+    string text(72, 'x');
+    text[pos] = '\r';
+    text[pos+1] = '\n';
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    BOOST_CHECK_EQUAL(detail::findCRLFSse2(begin, end) - begin, pos);
+    BOOST_CHECK_EQUAL(detail::findCRLFAvx2(begin, end) - begin, pos);
+    // CRLF split by the end of range is not found
+    BOOST_CHECK(detail::findCRLF(begin, begin + pos + 1) == NULL);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testFindByte)
+{
+  detail::FindByteFunc kernels[] =
+  {
+    detail::findByteScalar, detail::findByteSse2,
+    detail::findByteAvx2, detail::findByte,
+  };
+  srand(7);
+  for (int i = 0; i < 2000; ++i)
+  {
+    string text = randomText(rand() % 200);
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    for (detail::FindByteFunc find : kernels)
+    {
+      BOOST_CHECK_EQUAL(static_cast<const void*>(find(begin, end, '\n')),
+                        static_cast<const void*>(referenceByte(begin, end, '\n')));
+      BOOST_CHECK_EQUAL(static_cast<const void*>(find(begin, end, ':')),
+                        static_cast<const void*>(referenceByte(begin, end, ':')));
+    }
+  }
+}
@@ -0,0 +1,159 @@
+#include "muduo/net/ChainBuffer.h"
+
+//#define BOOST_TEST_MODULE ChainBufferTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::ChainBuffer;
+using muduo::net::SharedPayload;
+
+BOOST_AUTO_TEST_CASE(testChainBufferAppendRetrieve)
+{
+  ChainBuffer buf;
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 0);
+
+  const string str(200, 'x');
+  buf.append(str);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), str.size());
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 1);
+
+  buf.retrieve(50);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 150);
+
+  buf.append(string(100, 'y'));
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), string(150, 'x') + string(100, 'y'));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferCrossSlab)
+{
+  ChainBuffer buf;
+  const size_t len = ChainBuffer::kSlabSize * 3 + 100;
+  string str;
+  for (size_t i = 0; i < len; ++i)
+  {
+    str.push_back(static_cast<char>('a' + i % 26));
+  }
+  buf.append(str);
+  BOOST_CHECK_EQUAL(buf.readableBytes(), len);
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 4);
+
+  struct iovec vec[ChainBuffer::kMaxIovecs];
+  int n = buf.peekIovec(vec, ChainBuffer::kMaxIovecs);
+  BOOST_CHECK_EQUAL(n, 4);
+  BOOST_CHECK_EQUAL(vec[0].iov_len, ChainBuffer::kSlabSize);
+  BOOST_CHECK_EQUAL(vec[3].iov_len, 100);
+
+  buf.retrieve(ChainBuffer::kSlabSize + 10);
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 3);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), str.substr(ChainBuffer::kSlabSize + 10));
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferSharedPayload)
+{
+  SharedPayload payload(new string(ChainBuffer::kMinSharedBytes * 4, 'p'));
+  ChainBuffer buf1, buf2;
+  buf1.append(string(10, 'a'));
+  buf1.append(payload);
+  buf1.append(string(10, 'b'));
+  buf2.append(payload, 100);
+  BOOST_CHECK_EQUAL(payload.use_count(), 3);
+  BOOST_CHECK_EQUAL(buf1.numSlabs(), 3);
+  BOOST_CHECK_EQUAL(buf2.readableBytes(), payload->size() - 100);
+
+  struct iovec vec[ChainBuffer::kMaxIovecs];
+  int n = buf1.peekIovec(vec, ChainBuffer::kMaxIovecs);
+  BOOST_CHECK_EQUAL(n, 3);
+  BOOST_CHECK(vec[1].iov_base == payload->data());
+
+  buf1.retrieve(10 + payload->size() - 1);
+  BOOST_CHECK_EQUAL(payload.use_count(), 3);
+  buf1.retrieve(1);
+  BOOST_CHECK_EQUAL(payload.use_count(), 2);
+  BOOST_CHECK_EQUAL(buf1.retrieveAllAsString(), string(10, 'b'));
+  BOOST_CHECK_EQUAL(buf2.retrieveAllAsString(), payload->substr(100));
+  BOOST_CHECK_EQUAL(payload.use_count(), 1);
+
+  // short tails are copied
+  buf1.append(payload, payload->size() - 10);
+  BOOST_CHECK_EQUAL(payload.use_count(), 1);
+  BOOST_CHECK_EQUAL(buf1.readableBytes(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferWriteFd)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::pipe(fds), 0);
+
+  ChainBuffer buf;
+  const string str(ChainBuffer::kSlabSize + 1000, 'z');
+  buf.append(str);
+  int savedErrno = 0;
+  ssize_t n = buf.writeFd(fds[1], &savedErrno);
+  BOOST_CHECK_EQUAL(n, static_cast<ssize_t>(str.size()));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+
+  string received(str.size(), '\0');
+  size_t got = 0;
+  while (got < received.size())
+  {
+    ssize_t nr = ::read(fds[0], &received[got], received.size() - got);
+    BOOST_REQUIRE(nr > 0);
+    got += nr;
+  }
+  BOOST_CHECK_EQUAL(received, str);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferFile)
+{
+  char path[] = "/tmp/chainbuffer_unittest_XXXXXX";
+  int fileFd = ::mkstemp(path);
+  BOOST_REQUIRE(fileFd >= 0);
+  ::unlink(path);
+  const string content(100000, 'f');
+  BOOST_REQUIRE_EQUAL(::write(fileFd, content.data(), content.size()),
+                      static_cast<ssize_t>(content.size()));
+
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  ChainBuffer buf;
+  buf.append(string("head"));
+  buf.appendFile(fileFd, 10, 50000);
+  buf.append(string("tail"));
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 50008);
+  BOOST_CHECK_EQUAL(buf.numSlabs(), 3);
+
+  struct iovec vec[ChainBuffer::kMaxIovecs];
+  BOOST_CHECK_EQUAL(buf.peekIovec(vec, ChainBuffer::kMaxIovecs), 1);
+
+  string received;
+  while (received.size() < 50008)
+  {
+    if (buf.readableBytes() > 0)
+    {
+      int savedErrno = 0;
+      ssize_t n = buf.writeFd(fds[0], &savedErrno);
+      BOOST_REQUIRE(n > 0);
+    }
+    char tmp[65536];
+    ssize_t nr = ::read(fds[1], tmp, sizeof tmp);
+    BOOST_REQUIRE(nr > 0);
+    received.append(tmp, nr);
+  }
+  BOOST_CHECK_EQUAL(buf.readableBytes(), 0);
+  BOOST_CHECK(received == "head" + content.substr(10, 50000) + "tail");
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
@@ -43,12 +43,12 @@ void readTimerfd(int timerfd, Timestamp now);
 class PeriodicTimer
 {
  public:
-  PeriodicTimer(EventLoop* loop, double interval, const TimerCallback& cb)
+  PeriodicTimer(EventLoop* loop, double interval, TimerCallback cb)
     : loop_(loop),
       timerfd_(muduo::net::detail::createTimerfd()),    // 创建一个 时间fd
       timerfdChannel_(loop, timerfd_), // 创建时间fd 的 channel
       interval_(interval),    // 获得时间器间隔
-      cb_(cb)  // 回调函数
+      cb_(std::move(cb))  // 回调函数
   {
     // channel设置读取回调函数
     timerfdChannel_.setReadCallback(std::bind(&PeriodicTimer::handleRead, this));
@@ -1,5 +1,6 @@
 #include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Thread.h"
 
 #include <stdio.h>
@@ -63,6 +64,52 @@ int main()
     assert(nextLoop == model.getNextLoop());
   }
 
+  {
+    printf("Least connections:\n");
+    EventLoopThreadPool model(&loop, "connections");
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kLeastConnections);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    loops[0]->countConnection(2);
+    loops[1]->countConnection(1);
+    assert(model.getNextLoop() == loops[2]);
+    loops[2]->countConnection(3);
+    assert(model.getNextLoop() == loops[1]);
+    loops[1]->countConnection(1);
+    // ties go round-robin
+    assert(model.getNextLoop() == loops[0]);
+    assert(model.getNextLoop() == loops[1]);
+    assert(model.getNextLoop() == loops[0]);
+    loops[0]->countConnection(-2);
+    loops[1]->countConnection(-2);
+    loops[2]->countConnection(-3);
+  }
+
+  {
+    printf("Least queued:\n");
+    // outlive the threads of the pool
+    CountDownLatch blocked(1);
+    CountDownLatch latch(1);
+    EventLoopThreadPool model(&loop, "queued");
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kLeastQueued);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    // the first loop is stuck, with functors queued behind
+    loops[0]->runInLoop([&] { blocked.countDown(); latch.wait(); });
+    blocked.wait();
+    for (int i = 0; i < 10; ++i)
+    {
+      loops[0]->queueInLoop([] {});
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+      assert(model.getNextLoop() != loops[0]);
+    }
+    latch.countDown();
+  }
+
   loop.loop();
 }
 
@@ -1,8 +1,15 @@
 #include "muduo/net/EventLoop.h"
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 using namespace muduo;
@@ -27,8 +34,74 @@ void threadFunc()
   loop.loop();
 }
 
-int main()
+// N 个生产者线程同时向一个 loop 投递任务
+// measures queueInLoop() throughput and how many wakeups it costs
+void benchProducers(int numProducers, int numPerProducer)
 {
+  EventLoop loop;
+  const int64_t total = static_cast<int64_t>(numProducers) * numPerProducer;
+  int64_t done = 0;
+  size_t maxQueueSize = 0;
+  CountDownLatch ready(numProducers);
+  CountDownLatch go(1);
+
+  std::vector<std::unique_ptr<Thread>> producers;
+  for (int i = 0; i < numProducers; ++i)
+  {
+    producers.emplace_back(new Thread([&, i] {
+      ready.countDown();
+      go.wait();
+      for (int j = 0; j < numPerProducer; ++j)
+      {
+        loop.queueInLoop([&] {
+          if (++done == total)
+          {
+            loop.quit();
+          }
+        });
+        // 偶尔停一下，让 loop 有机会阻塞在 poll 中
+        if (j % 1024 == 0)
+        {
+          if (i == 0)
+          {
+            maxQueueSize = std::max(maxQueueSize, loop.queueSize());
+          }
+          ::usleep(10);
+        }
+      }
+    }));
+    producers.back()->start();
+  }
+  ready.wait();
+
+  const int64_t wakeups = loop.wakeupCount();
+  Timestamp start(Timestamp::now());
+  go.countDown();
+  loop.loop();
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (auto& thr : producers)
+  {
+    thr->join();
+  }
+  assert(done == total);
+  printf("%d producers %.0f functors/s %.4f wakeups/functor %ld iterations "
+         "max queue size %zu\n",
+         numProducers, static_cast<double>(total) / seconds,
+         static_cast<double>(loop.wakeupCount() - wakeups) / static_cast<double>(total),
+         static_cast<long>(loop.iteration()), maxQueueSize);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+  {
+    // eventloop_unittest numProducers [numPerProducer]
+    int numProducers = atoi(argv[1]);
+    int numPerProducer = argc > 2 ? atoi(argv[2]) : 1000000;
+    benchProducers(numProducers, numPerProducer);
+    return 0;
+  }
+
   printf("main(): pid = %d, tid = %d\n", getpid(), CurrentThread::tid());
 
   assert(EventLoop::getEventLoopOfCurrentThread() == NULL);
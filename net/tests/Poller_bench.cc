@@ -0,0 +1,240 @@
+// 比较 epoll / poll / io_uring 三种 Poller：短连接（连接建立与关闭）和 ping-pong 吞吐量
+
+#include "muduo/net/poller/IoUringPoller.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 23457;
+
+// the environment is read when an EventLoop creates its poller
+void useBackend(const char* name)
+{
+  ::unsetenv("MUDUO_USE_POLL");
+  ::unsetenv("MUDUO_USE_IO_URING");
+  if (strcmp(name, "poll") == 0)
+  {
+    ::setenv("MUDUO_USE_POLL", "1", 1);
+  }
+  else if (strcmp(name, "io_uring") == 0)
+  {
+    ::setenv("MUDUO_USE_IO_URING", "1", 1);
+  }
+}
+
+// TcpServer must be destroyed in its loop thread
+void stopServer(EventLoop* loop, std::unique_ptr<TcpServer>* server)
+{
+  CountDownLatch latch(1);
+  loop->runInLoop([&] {
+    server->reset();
+    latch.countDown();
+  });
+  latch.wait();
+}
+
+void onEcho(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+// 每个连接：connect, 1 字节往返, close
+// measures accept, register, unregister and close on the server loop
+double churn(int numConnections, bool completion)
+{
+  EventLoopThread serverThread;
+  EventLoop* serverLoop = serverThread.startLoop();
+  InetAddress listenAddr(kPort, true);
+  std::unique_ptr<TcpServer> server;
+  serverLoop->runInLoop([&] {
+    server.reset(new TcpServer(serverLoop, listenAddr, "ChurnServer"));
+    // the server closes first, TIME_WAIT stays there and clients
+    // don't run out of ports
+    server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+      conn->send(buf);
+      conn->shutdown();
+    });
+    server->setCompletionMode(completion);
+    server->start();
+  });
+  ::usleep(100*1000);
+
+  Timestamp start(Timestamp::now());
+  int done = 0;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0)
+    {
+      ::close(fd);
+      continue;
+    }
+    char c = 'x';
+    if (::write(fd, &c, 1) == 1 && ::read(fd, &c, 1) == 1 && ::read(fd, &c, 1) == 0)
+    {
+      ++done;
+    }
+    ::close(fd);
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+
+  // let the server see the last close
+  ::usleep(100*1000);
+  stopServer(serverLoop, &server);
+  return done / seconds;
+}
+
+// 多个连接同时收发固定大小的消息
+class PingPongClient : noncopyable
+{
+ public:
+  PingPongClient(EventLoop* loop, const InetAddress& serverAddr, size_t blockSize)
+    : client_(loop, serverAddr, "PingPongClient"),
+      message_(blockSize, 'p'),
+      bytesRead_(0),
+      messagesRead_(0)
+  {
+    client_.setConnectionCallback(
+        std::bind(&PingPongClient::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&PingPongClient::onMessage, this, _1, _2, _3));
+  }
+
+  void connect() { client_.connect(); }
+  void disconnect() { client_.disconnect(); }
+  int64_t bytesRead() const { return bytesRead_; }
+  int64_t messagesRead() const { return messagesRead_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+      conn->send(message_);
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    bytesRead_ += buf->readableBytes();
+    ++messagesRead_;
+    conn->send(buf);
+  }
+
+  TcpClient client_;
+  string message_;
+  int64_t bytesRead_;
+  int64_t messagesRead_;
+};
+
+// @return messages per second
+double pingpong(int numConnections, size_t blockSize, double seconds,
+                bool edgeTriggered, bool completion, double* mibps)
+{
+  EventLoopThread serverThread;
+  EventLoop* serverLoop = serverThread.startLoop();
+  InetAddress listenAddr(kPort, true);
+  std::unique_ptr<TcpServer> server;
+  serverLoop->runInLoop([&] {
+    server.reset(new TcpServer(serverLoop, listenAddr, "PingPongServer"));
+    server->setMessageCallback(onEcho);
+    server->setConnectionCallback([](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+      }
+    });
+    // multishot polls with io_uring
+    server->setEdgeTriggered(edgeTriggered);
+    // recv and send through io_uring, the other backends ignore it
+    server->setCompletionMode(completion);
+    server->start();
+  });
+  ::usleep(100*1000);
+
+  EventLoop loop;
+  std::vector<std::unique_ptr<PingPongClient>> clients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    clients.emplace_back(new PingPongClient(&loop, listenAddr, blockSize));
+    clients.back()->connect();
+  }
+  int64_t bytes = 0;
+  int64_t messages = 0;
+  // 先预热，然后计时
+  const double kWarmUp = 0.2;
+  loop.runAfter(kWarmUp, [&] {
+    for (const auto& client : clients)
+    {
+      bytes -= client->bytesRead();
+      messages -= client->messagesRead();
+    }
+  });
+  loop.runAfter(kWarmUp + seconds, [&] {
+    for (const auto& client : clients)
+    {
+      bytes += client->bytesRead();
+      messages += client->messagesRead();
+      client->disconnect();
+    }
+    loop.runAfter(0.1, [&] { loop.quit(); });
+  });
+  loop.loop();
+  clients.clear();
+
+  stopServer(serverLoop, &server);
+  *mibps = static_cast<double>(bytes) / seconds / (1024*1024);
+  return static_cast<double>(messages) / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  int numChurn = argc > 1 ? atoi(argv[1]) : 10000;
+  int numConnections = argc > 2 ? atoi(argv[2]) : 100;
+  size_t blockSize = argc > 3 ? atoi(argv[3]) : 64;
+  double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+  // "et" or "completion"
+  bool edgeTriggered = argc > 5 && strcmp(argv[5], "et") == 0;
+  bool completion = argc > 5 && strcmp(argv[5], "completion") == 0;
+  Logger::setLogLevel(Logger::WARN);
+
+  const char* backends[] = { "epoll", "poll", "io_uring" };
+  printf("%-10s %12s %12s %10s\n", "backend", "churn conn/s", "pingpong m/s", "MiB/s");
+  for (const char* backend : backends)
+  {
+    if (strcmp(backend, "io_uring") == 0 && !IoUringPoller::isSupported())
+    {
+      printf("%-10s not supported by this kernel\n", backend);
+      continue;
+    }
+    useBackend(backend);
+    double connRate = churn(numChurn, completion);
+    double mibps = 0;
+    double msgRate = pingpong(numConnections, blockSize, seconds, edgeTriggered, completion, &mibps);
+    printf("%-10s %12.0f %12.0f %10.1f\n", backend, connRate, msgRate, mibps);
+  }
+}
@@ -0,0 +1,267 @@
+// Task 与 std::function 对比：构造+调用的耗时和堆分配次数，以及跨线程 runInLoop 的分配次数
+// 和跨线程 send(string&&)/send(Buffer&&) 每次交接的分配次数
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpConnection.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Task.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 统计所有线程的 operator new 次数，以及本线程的
+std::atomic<int64_t> g_allocations(0);
+thread_local int64_t t_allocations = 0;
+
+void* operator new(size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  ++t_allocations;
+  void* p = ::malloc(size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  ::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  ::free(p);
+}
+
+namespace
+{
+
+// stands for a TcpConnection
+class Session : public std::enable_shared_from_this<Session>
+{
+ public:
+  Session() : count_(0), bytes_(0) {}
+
+  void onTick() { ++count_; }
+  void onData(const std::string& data) { bytes_ += data.size(); }
+
+  int64_t count_;
+  int64_t bytes_;
+};
+
+typedef std::shared_ptr<Session> SessionPtr;
+
+// 与 TcpServer::newConnection, TcpConnection::send 中相同形状的回调
+std::function<void()> bindShared(const SessionPtr& session)
+{
+  return std::bind(&Session::onTick, session);
+}
+
+template<typename Callable, typename MakeFunctor>
+void benchConstruct(const char* name, int n, MakeFunctor make)
+{
+  int64_t allocations = g_allocations.load();
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    Callable f(make());
+    f();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-40s %8.1f ns %6.2f allocs\n", name, seconds * 1e9 / n,
+         static_cast<double>(g_allocations.load() - allocations) / n);
+}
+
+template<typename Callable>
+void benchCallables(const char* type, int n)
+{
+  SessionPtr session(new Session);
+  Session* raw = get_pointer(session);
+  const std::string data("short payload");    // SSO, no allocation itself
+  char name[64];
+
+  snprintf(name, sizeof name, "%s bind(mf, shared_ptr)", type);
+  benchConstruct<Callable>(name, n, [&] {
+    return std::bind(&Session::onTick, session);
+  });
+
+  snprintf(name, sizeof name, "%s bind(mf, this, string)", type);
+  benchConstruct<Callable>(name, n, [&] {
+    return std::bind(&Session::onData, raw, data);
+  });
+
+  snprintf(name, sizeof name, "%s lambda(shared_ptr, int64)", type);
+  benchConstruct<Callable>(name, n, [&] {
+    int64_t x = 42;
+    return [session, x] { session->count_ += x; };
+  });
+}
+
+// 主线程向一个 loop 投递 n 个回调
+void benchRunInLoop(int n)
+{
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  SessionPtr session(new Session);
+  const std::string data("short payload");
+
+  // warm up, fills the node pool of the loop
+  for (int i = 0; i < n; ++i)
+  {
+    loop->runInLoop(std::bind(&Session::onTick, session));
+  }
+  CountDownLatch warmed(1);
+  loop->runInLoop([&warmed] { warmed.countDown(); });
+  warmed.wait();
+
+  CountDownLatch latch(1);
+  int64_t allocations = g_allocations.load();
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    if (i % 2 == 0)
+    {
+      loop->runInLoop(std::bind(&Session::onTick, session));
+    }
+    else
+    {
+      loop->runInLoop(std::bind(&Session::onData, get_pointer(session), data));
+    }
+  }
+  loop->runInLoop([&latch] { latch.countDown(); });
+  latch.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-40s %8.1f ns %6.2f allocs\n", "runInLoop from another thread",
+         seconds * 1e9 / n,
+         static_cast<double>(g_allocations.load() - allocations) / n);
+}
+
+void runInLoopAndWait(EventLoop* loop, const std::function<void()>& cb)
+{
+  CountDownLatch latch(1);
+  loop->runInLoop([&] { cb(); latch.countDown(); });
+  latch.wait();
+}
+
+// 主线程向一个 loop 中的连接发送 n 条消息，对端另一个线程读走
+template<typename Message, typename MakeMessage>
+void benchSend(const char* name, int n, MakeMessage make)
+{
+  const size_t kMessageSize = 100;    // longer than SSO
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds);
+  assert(ret == 0); (void)ret;
+  TcpConnectionPtr conn;
+  runInLoopAndWait(loop, [&] {
+    conn = std::make_shared<TcpConnection>(loop, "bench", fds[0],
+                                           InetAddress(), InetAddress());
+    conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+      buf->retrieveAll();
+    });
+    conn->connectEstablished();
+  });
+
+  const int peer = fds[1];
+  const size_t total = kMessageSize * n * 2;
+  Thread reader([peer, total] {
+    char buf[65536];
+    size_t received = 0;
+    while (received < total)
+    {
+      ssize_t nr = ::read(peer, buf, sizeof buf);
+      if (nr > 0)
+      {
+        received += nr;
+      }
+      else
+      {
+        ::usleep(100);
+      }
+    }
+  });
+
+  std::vector<Message> messages;
+  messages.reserve(n);
+  for (int i = 0; i < n; ++i)
+  {
+    messages.push_back(make(kMessageSize));
+  }
+  reader.start();
+  // warm up with the loop held, the node pool gets a node for each send
+  CountDownLatch held(1);
+  loop->runInLoop([&held] { held.wait(); });
+  for (int i = 0; i < n; ++i)
+  {
+    conn->send(make(kMessageSize));
+  }
+  held.countDown();
+  runInLoopAndWait(loop, [] {});
+  // the loop thread may grow the output buffer, count this thread only
+  int64_t allocations = t_allocations;
+  Timestamp start(Timestamp::now());
+  for (Message& message : messages)
+  {
+    conn->send(std::move(message));
+  }
+  allocations = t_allocations - allocations;
+  reader.join();
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-40s %8.1f ns %6.2f allocs\n", name, seconds * 1e9 / n,
+         static_cast<double>(allocations) / n);
+
+  runInLoopAndWait(loop, [&] {
+    conn->connectDestroyed();
+    conn.reset();
+  });
+  ::close(peer);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  printf("sizeof(std::function<void()>) = %zu, sizeof(Task) = %zu\n",
+         sizeof(std::function<void()>), sizeof(Task));
+  benchCallables<std::function<void()>>("std::function", n);
+  benchCallables<Task>("Task", n);
+  // std::function converts to Task, but keeps its own allocation
+  benchConstruct<Task>("Task from std::function", n, [] {
+    static SessionPtr session(new Session);
+    return bindShared(session);
+  });
+  benchRunInLoop(n);
+  // 消息预先构造，只统计交接；输出缓冲区偶尔分配 slab
+  benchSend<std::string>("send(string&&) from another thread", n / 10,
+                         [](size_t len) { return std::string(len, 'x'); });
+  benchSend<Buffer>("send(Buffer&&) from another thread", n / 10,
+                    [](size_t len) {
+                      Buffer buf(len);
+                      buf.ensureWritableBytes(len);
+                      buf.hasWritten(len);
+                      return buf;
+                    });
+}
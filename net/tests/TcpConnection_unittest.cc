@@ -0,0 +1,1168 @@
+// 连接迁移：缓冲区、context 和回调迁移后保持不变
+// 其他线程发送：按顺序到达，移动过来的数据不拷贝
+// sendv：没写完的各段按顺序排队
+// 写合并：每个线程的消息保持顺序，一批暂存的发送只唤醒一次 loop
+// 边沿触发：读写到 EAGAIN，用完预算推迟到下一轮
+// 公平性预算：水平触发每个事件只读一次
+// 完成模式：io_uring 回显完整有序
+
+#include "muduo/net/TcpServer.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/poller/IoUringPoller.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kBigMessage = 32*1024*1024;
+
+EventLoop* g_baseLoop;
+std::unique_ptr<TcpServer> g_server;
+std::vector<EventLoop*> g_loops;
+
+MutexLock g_mutex;
+TcpConnectionPtr g_conn GUARDED_BY(g_mutex);
+std::unique_ptr<CountDownLatch> g_connected;
+std::unique_ptr<CountDownLatch> g_disconnected;
+
+EventLoop* firstLoop(const std::vector<EventLoop*>& loops)
+{
+  return loops[0];
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  assert(conn->getLoop()->isInLoopThread());
+  if (conn->connected())
+  {
+    conn->setContext(0);
+    {
+    MutexLockGuard lock(g_mutex);
+    g_conn = conn;
+    }
+    g_connected->countDown();
+  }
+  else
+  {
+    g_disconnected->countDown();
+  }
+}
+
+// 每行回复 "行 序号"，"big" 回复 kBigMessage 字节
+void onLineMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  assert(conn->getLoop()->isInLoopThread());
+  while (const char* eol = buf->findEOL())
+  {
+    string line(buf->peek(), eol);
+    buf->retrieveUntil(eol + 1);
+    int* count = boost::any_cast<int>(conn->getMutableContext());
+    ++*count;
+    if (line == "big")
+    {
+      conn->send(string(kBigMessage, 'x'));
+    }
+    else
+    {
+      char reply[64];
+      snprintf(reply, sizeof reply, "%s %d\n", line.c_str(), *count);
+      conn->send(reply);
+    }
+  }
+}
+
+// 每个字节忙 2ms 再回复，让 loop 一直忙碌
+void onBusyMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  while (buf->readableBytes() > 0)
+  {
+    Timestamp start(Timestamp::now());
+    while (timeDifference(Timestamp::now(), start) < 0.002)
+    {
+    }
+    conn->send(buf->peek(), 1);
+    buf->retrieve(1);
+  }
+}
+
+void runInBaseLoop(const std::function<void()>& f)
+{
+  CountDownLatch latch(1);
+  g_baseLoop->runInLoop([&] { f(); latch.countDown(); });
+  latch.wait();
+}
+
+// 排在 loop 中已有的函数之后
+void drain(EventLoop* loop)
+{
+  CountDownLatch latch(1);
+  loop->queueInLoop([&] { latch.countDown(); });
+  latch.wait();
+}
+
+// migrate() 在原 loop 中排队两次，再在新的 loop 中注册
+void waitForMigration(EventLoop* from, EventLoop* to)
+{
+  drain(from);
+  drain(from);
+  drain(to);
+}
+
+void startServer(uint16_t port, const MessageCallback& cb, double rebalanceThreshold,
+                 TcpServer::Option option = TcpServer::kNoReusePort)
+{
+  runInBaseLoop([&] {
+    g_server.reset(new TcpServer(g_baseLoop, InetAddress(port, true), "migrate", option));
+    g_server->setThreadNum(2);
+    g_server->setPlacementCallback(firstLoop);
+    if (rebalanceThreshold > 0)
+    {
+      g_server->setRebalancing(rebalanceThreshold);
+    }
+    g_server->setConnectionCallback(onConnection);
+    g_server->setMessageCallback(cb);
+    g_server->start();
+    g_loops = g_server->threadPool()->getAllLoops();
+  });
+}
+
+void stopServer()
+{
+  // connectDestroyed() comes after TcpServer::removeConnectionInLoop()
+  for (EventLoop* loop : g_loops)
+  {
+    while (loop->numConnections() > 0)
+    {
+      ::usleep(1000);
+    }
+  }
+  runInBaseLoop([] { g_server.reset(); });
+  {
+  MutexLockGuard lock(g_mutex);
+  g_conn.reset();
+  }
+}
+
+// rcvbuf 0 keeps the default
+int connectTo(uint16_t port, int rcvbuf = 0)
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval timeout = { 10, 0 };
+  ::setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  if (rcvbuf > 0)
+  {
+    ::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  }
+  struct sockaddr_in addr;
+  memZero(&addr, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int ret = ::connect(sockfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+  assert(ret == 0); (void)ret;
+  return sockfd;
+}
+
+void writeAll(int sockfd, const string& data)
+{
+  ssize_t n = ::write(sockfd, data.data(), data.size());
+  assert(n == static_cast<ssize_t>(data.size())); (void)n;
+}
+
+string readExactly(int sockfd, size_t len)
+{
+  string data(len, '\0');
+  size_t got = 0;
+  while (got < len)
+  {
+    ssize_t n = ::read(sockfd, &data[got], len - got);
+    assert(n > 0);
+    got += n;
+  }
+  return data;
+}
+
+void testMigrate(uint16_t port)
+{
+  printf("Migrate:\n");
+  g_connected.reset(new CountDownLatch(1));
+  g_disconnected.reset(new CountDownLatch(1));
+  startServer(port, onLineMessage, 0.0);
+  int sockfd = connectTo(port);
+  g_connected->wait();
+  TcpConnectionPtr conn;
+  {
+  MutexLockGuard lock(g_mutex);
+  conn = g_conn;
+  }
+  assert(conn->getLoop() == g_loops[0]);
+
+  // 输入缓冲区中留下半行，输出缓冲区中留下大量没有发出的数据
+  writeAll(sockfd, "big\nhel");
+  bool pending = false;
+  for (int i = 0; i < 100 && !pending; ++i)
+  {
+    ::usleep(10*1000);
+    g_loops[0]->runInLoop([&] {
+      pending = conn->outputBuffer()->readableBytes() > 0
+          && conn->inputBuffer()->readableBytes() == 3;
+    });
+    drain(g_loops[0]);
+  }
+  assert(pending);
+
+  conn->send("before\n");
+  conn->migrate(g_loops[1]);
+  conn->send("after\n");
+  waitForMigration(g_loops[0], g_loops[1]);
+  assert(conn->getLoop() == g_loops[1]);
+  assert(g_loops[0]->numConnections() == 0);
+  assert(g_loops[1]->numConnections() == 1);
+  // buffer storage is accounted to the new loop's pool
+  assert(g_loops[0]->bufferPool()->inUseBytes() == 0);
+  assert(g_loops[1]->bufferPool()->inUseBytes() > 0);
+
+  // 顺序不变
+  string big = readExactly(sockfd, kBigMessage);
+  assert(big == string(kBigMessage, 'x'));
+  assert(readExactly(sockfd, 13) == "before\nafter\n");
+  writeAll(sockfd, "lo\n");
+  assert(readExactly(sockfd, 8) == "hello 2\n");
+
+  // 迁移回来
+  conn->migrate(g_loops[0]);
+  waitForMigration(g_loops[1], g_loops[0]);
+  assert(conn->getLoop() == g_loops[0]);
+  writeAll(sockfd, "again\n");
+  assert(readExactly(sockfd, 8) == "again 3\n");
+
+  conn.reset();
+  ::close(sockfd);
+  g_disconnected->wait();
+  while (g_loops[0]->numConnections() > 0)
+  {
+    ::usleep(1000);
+  }
+  // connectDestroyed() returns the storage after counting the connection out
+  drain(g_loops[0]);
+  assert(g_loops[0]->bufferPool()->inUseBytes() == 0);
+  assert(g_loops[1]->bufferPool()->inUseBytes() == 0);
+  stopServer();
+}
+
+void testRebalance(uint16_t port)
+{
+  printf("Rebalance:\n");
+  const int kConnections = 4;
+  g_connected.reset(new CountDownLatch(kConnections));
+  g_disconnected.reset(new CountDownLatch(kConnections));
+  startServer(port, onBusyMessage, 0.5);
+  std::vector<int> sockets;
+  for (int i = 0; i < kConnections; ++i)
+  {
+    sockets.push_back(connectTo(port));
+  }
+  g_connected->wait();
+  assert(g_loops[0]->numConnections() == kConnections);
+
+  Timestamp start(Timestamp::now());
+  while (g_loops[1]->numConnections() == 0 && timeDifference(Timestamp::now(), start) < 10)
+  {
+    for (int sockfd : sockets)
+    {
+      writeAll(sockfd, "x");
+      assert(readExactly(sockfd, 1) == "x");
+    }
+  }
+  printf("moved %d connections in %.2fs\n", g_loops[1]->numConnections(),
+         timeDifference(Timestamp::now(), start));
+  assert(g_loops[1]->numConnections() > 0);
+  assert(g_loops[1]->numConnections() < kConnections);
+
+  // 迁移后的连接照常工作
+  for (int i = 0; i < 10; ++i)
+  {
+    for (int sockfd : sockets)
+    {
+      writeAll(sockfd, "y");
+      assert(readExactly(sockfd, 1) == "y");
+    }
+  }
+  for (int sockfd : sockets)
+  {
+    ::close(sockfd);
+  }
+  g_disconnected->wait();
+  stopServer();
+}
+
+// 每个 loop 自己 accept，迁移走的连接关闭时从原 loop 的连接表删除
+// 端口 0 时所有 loop 监听同一个内核选择的端口
+void testListenPerLoop()
+{
+  printf("ListenPerLoop:\n");
+  const int kConnections = 16;
+  g_connected.reset(new CountDownLatch(kConnections));
+  g_disconnected.reset(new CountDownLatch(kConnections));
+  startServer(0, onLineMessage, 0.0, TcpServer::kReusePortPerLoop);
+  const uint16_t port = g_server->listenAddress().toPort();
+  assert(port != 0);
+  // listen() runs in the IO loops
+  drain(g_loops[0]);
+  drain(g_loops[1]);
+  std::vector<int> sockets;
+  for (int i = 0; i < kConnections; ++i)
+  {
+    sockets.push_back(connectTo(port));
+  }
+  g_connected->wait();
+  printf("loop 0: %d, loop 1: %d\n",
+         g_loops[0]->numConnections(), g_loops[1]->numConnections());
+  assert(g_loops[0]->numConnections() + g_loops[1]->numConnections() == kConnections);
+
+  TcpConnectionPtr conn;
+  {
+  MutexLockGuard lock(g_mutex);
+  conn = g_conn;
+  }
+  EventLoop* from = conn->getLoop();
+  EventLoop* to = from == g_loops[0] ? g_loops[1] : g_loops[0];
+  conn->migrate(to);
+  waitForMigration(from, to);
+  assert(conn->getLoop() == to);
+  conn.reset();
+
+  for (int sockfd : sockets)
+  {
+    writeAll(sockfd, "ping\n");
+    assert(readExactly(sockfd, 7) == "ping 1\n");
+    ::close(sockfd);
+  }
+  g_disconnected->wait();
+  stopServer();
+}
+
+TcpConnectionPtr currentConnection()
+{
+  MutexLockGuard lock(g_mutex);
+  return g_conn;
+}
+
+// 在连接的 loop 中读取输出缓冲区的状态
+void outputBufferState(const TcpConnectionPtr& conn, size_t* readable, size_t* slabs)
+{
+  CountDownLatch latch(1);
+  conn->getLoop()->runInLoop([&] {
+    *readable = conn->outputBuffer()->readableBytes();
+    *slabs = conn->outputBuffer()->numSlabs();
+    latch.countDown();
+  });
+  latch.wait();
+}
+
+// 其他线程用 send(string&&)、send(Buffer&&) 和 send(const char*) 发送，按顺序到达，
+// 移动过的参数变为空，没写完的长 string 作为 payload 段排队而不拷贝
+void testSendFromOtherThread(uint16_t port)
+{
+  printf("SendFromOtherThread:\n");
+  g_connected.reset(new CountDownLatch(1));
+  g_disconnected.reset(new CountDownLatch(1));
+  startServer(port, onLineMessage, 0.0);
+  // the client doesn't read until everything is sent
+  int sockfd = connectTo(port, 64*1024);
+  g_connected->wait();
+  TcpConnectionPtr conn = currentConnection();
+
+  string expected;
+  for (int i = 0; i < 100; ++i)
+  {
+    string message = "string " + std::to_string(i) + "\n";
+    expected += message;
+    conn->send(std::move(message));
+    assert(message.empty());
+
+    Buffer buf;
+    buf.append("buffer " + std::to_string(i) + "\n");
+    expected += buf.toStringPiece().as_string();
+    conn->send(std::move(buf));
+    assert(buf.readableBytes() == 0);
+
+    conn->send("literal\n");
+    expected += "literal\n";
+  }
+  string big(kBigMessage, 'b');
+  big[0] = 'B';
+  expected += big;
+  conn->send(std::move(big));
+  assert(big.empty());
+  conn->send("tail\n");
+  expected += "tail\n";
+
+  drain(conn->getLoop());
+  size_t queued = 0;
+  size_t slabs = 0;
+  outputBufferState(conn, &queued, &slabs);
+  printf("%zu bytes queued in %zu slabs\n", queued, slabs);
+  // copied, the tail would take queued / kSlabSize slabs
+  assert(queued > ChainBuffer::kSlabSize * 16);
+  assert(slabs < 4);
+
+  assert(readExactly(sockfd, expected.size()) == expected);
+  conn.reset();
+  ::close(sockfd);
+  g_disconnected->wait();
+  stopServer();
+}
+
+// 第 call 次 sendv 的分段，大小和内容各不相同
+std::vector<string> makePieces(int call, int count)
+{
+  std::vector<string> pieces;
+  for (int i = 0; i < count; ++i)
+  {
+    pieces.push_back(string(64*1024 + 997 * i, static_cast<char>('A' + (call * count + i) % 26)));
+  }
+  return pieces;
+}
+
+std::vector<StringPiece> piecesOf(const std::vector<string>& strings)
+{
+  return std::vector<StringPiece>(strings.begin(), strings.end());
+}
+
+size_t bytesOf(const std::vector<string>& strings)
+{
+  size_t bytes = 0;
+  for (const string& str : strings)
+  {
+    bytes += str.size();
+  }
+  return bytes;
+}
+
+// sendv 部分写出时，各段没写完的部分按顺序排在已有输出之后
+void testSendvPartial(uint16_t port)
+{
+  printf("SendvPartial:\n");
+  g_connected.reset(new CountDownLatch(1));
+  g_disconnected.reset(new CountDownLatch(1));
+  startServer(port, onLineMessage, 0.0);
+  // the client doesn't read until everything is sent
+  int sockfd = connectTo(port, 64*1024);
+  g_connected->wait();
+  TcpConnectionPtr conn = currentConnection();
+
+  // sendv in the loop until one is written partly, then once more,
+  // then once from another thread
+  const int kPieces = ChainBuffer::kMaxIovecs / 2;
+  const int kMaxCalls = 64;
+  std::vector<std::vector<string>> calls;
+  string expected;
+  int partial = -1;
+  size_t queuedPartial = 0;
+  size_t queuedBehind = 0;
+  CountDownLatch sent(1);
+  conn->getLoop()->runInLoop([&] {
+    for (int call = 0; call < kMaxCalls && partial < 0; ++call)
+    {
+      calls.push_back(makePieces(call, kPieces));
+      std::vector<StringPiece> vec = piecesOf(calls.back());
+      conn->sendv(vec.data(), vec.size());
+      if (conn->outputBuffer()->readableBytes() > 0)
+      {
+        partial = call;
+        queuedPartial = conn->outputBuffer()->readableBytes();
+      }
+    }
+    // queued behind the tail of the partial write
+    calls.push_back(makePieces(static_cast<int>(calls.size()), kPieces));
+    std::vector<StringPiece> vec = piecesOf(calls.back());
+    conn->sendv(vec.data(), vec.size());
+    queuedBehind = conn->outputBuffer()->readableBytes();
+    sent.countDown();
+  });
+  sent.wait();
+  // from another thread, concatenated once and queued last
+  calls.push_back(makePieces(static_cast<int>(calls.size()), kPieces));
+  std::vector<StringPiece> vec = piecesOf(calls.back());
+  conn->sendv(vec.data(), vec.size());
+  for (const std::vector<string>& pieces : calls)
+  {
+    for (const string& piece : pieces)
+    {
+      expected += piece;
+    }
+  }
+
+  assert(partial >= 0);
+  const size_t callBytes = bytesOf(calls[partial]);
+  printf("sendv #%d wrote %zu of %zu bytes, %zu queued after the next\n",
+         partial, callBytes - queuedPartial, callBytes, queuedBehind);
+  // the unwritten tail covers several pieces
+  assert(queuedPartial > calls[partial].back().size() && queuedPartial <= callBytes);
+  assert(queuedBehind == queuedPartial + bytesOf(calls[partial + 1]));
+
+  assert(readExactly(sockfd, expected.size()) == expected);
+  conn.reset();
+  ::close(sockfd);
+  g_disconnected->wait();
+  stopServer();
+}
+
+// 写合并：多个线程发送，每个线程的消息保持顺序；与 loop 中的发送交替时也保持顺序
+void testWriteCoalescing(uint16_t port)
+{
+  printf("WriteCoalescing:\n");
+  g_connected.reset(new CountDownLatch(1));
+  g_disconnected.reset(new CountDownLatch(1));
+  startServer(port, onLineMessage, 0.0);
+  int sockfd = connectTo(port);
+  g_connected->wait();
+  TcpConnectionPtr conn = currentConnection();
+  EventLoop* loop = conn->getLoop();
+  CountDownLatch enabled(1);
+  loop->runInLoop([&] {
+    conn->setWriteCoalescing(true);
+    enabled.countDown();
+  });
+  enabled.wait();
+
+  // 各线程的消息 "t<线程> <序号>"
+  const int kThreads = 4;
+  const int kMessages = 2000;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back(new Thread([conn, t, kMessages] {
+      for (int i = 0; i < kMessages; ++i)
+      {
+        char message[32];
+        snprintf(message, sizeof message, "t%d %d\n", t, i);
+        conn->send(message);
+      }
+    }));
+  }
+  for (auto& thread : threads)
+  {
+    thread->start();
+  }
+  for (auto& thread : threads)
+  {
+    thread->join();
+  }
+
+  // 其他线程和 loop 交替发送 "m <序号>"，loop 中的发送先写出暂存的数据
+  const int kMixed = 1000;
+  for (int i = 0; i < kMixed; ++i)
+  {
+    char message[32];
+    snprintf(message, sizeof message, "m %d\n", i);
+    if (i % 3 == 2)
+    {
+      // the staged sends are flushed after pending functors, so this one
+      // comes first unless it flushes them
+      CountDownLatch sent(1);
+      string inLoop(message);
+      loop->runInLoop([&] {
+        conn->send(inLoop);
+        sent.countDown();
+      });
+      sent.wait();
+    }
+    else
+    {
+      conn->send(message);
+    }
+  }
+
+  // the loop is held, a burst of staged sends and flushes wakes it once
+  CountDownLatch entered(1);
+  CountDownLatch held(1);
+  loop->runInLoop([&] {
+    entered.countDown();
+    held.wait();
+  });
+  entered.wait();
+  const int64_t wakeups = loop->wakeupCount();
+  const int kBurst = 100;
+  for (int i = 0; i < kBurst; ++i)
+  {
+    conn->send("burst\n");
+    // as other connections of the loop would
+    loop->queueFlush([] {});
+  }
+  const int64_t burstWakeups = loop->wakeupCount() - wakeups;
+  held.countDown();
+
+  std::vector<int> next(kThreads, 0);
+  int nextMixed = 0;
+  int bursts = 0;
+  string pending;
+  while (bursts < kBurst)
+  {
+    char buf[65536];
+    ssize_t n = ::read(sockfd, buf, sizeof buf);
+    assert(n > 0);
+    pending.append(buf, n);
+    size_t eol;
+    while ((eol = pending.find('\n')) != string::npos)
+    {
+      string line = pending.substr(0, eol);
+      pending.erase(0, eol + 1);
+      int t = 0;
+      int i = 0;
+      if (sscanf(line.c_str(), "t%d %d", &t, &i) == 2)
+      {
+        assert(i == next[t]);
+        ++next[t];
+      }
+      else if (sscanf(line.c_str(), "m %d", &i) == 1)
+      {
+        // all threads were joined before
+        assert(i == nextMixed);
+        ++nextMixed;
+      }
+      else
+      {
+        assert(line == "burst");
+        assert(nextMixed == kMixed);
+        ++bursts;
+      }
+    }
+  }
+  printf("%d wakeups for %d staged sends\n", static_cast<int>(burstWakeups), kBurst);
+  for (int t = 0; t < kThreads; ++t)
+  {
+    assert(next[t] == kMessages);
+  }
+  assert(burstWakeups == 1);
+
+  conn.reset();
+  ::close(sockfd);
+  g_disconnected->wait();
+  stopServer();
+}
+
+// 单独 loop 上的服务器，记录消息回调读到的字节和所在的循环轮次，
+// 读够 replyAfter 字节后回复 replyBytes 字节
+class RecordingServer : noncopyable
+{
+ public:
+  struct Options
+  {
+    size_t channelBytes = 0;        // EventLoop::setChannelBudget()
+    int64_t channelMicros = 0;
+    bool edgeTriggered = false;     // TcpServer::setEdgeTriggered()
+    size_t eventBudget = 0;
+    int64_t callbackMicros = 0;     // 每次回调忙这么久
+    size_t replyAfter = 0;
+    size_t replyBytes = 0;
+  };
+
+  RecordingServer(uint16_t port, const Options& options)
+    : options_(options),
+      thread_([options](EventLoop* loop) {
+        loop->setChannelBudget(options.channelBytes, options.channelMicros);
+      }),
+      loop_(thread_.startLoop()),
+      bytes_(0),
+      callbacks_(0)
+  {
+    inLoop([this, port] {
+      server_.reset(new TcpServer(loop_, InetAddress(port, true), "recording"));
+      server_->setEdgeTriggered(options_.edgeTriggered, options_.eventBudget);
+      server_->setMessageCallback(
+          std::bind(&RecordingServer::onMessage, this, _1, _2, _3));
+      server_->start();
+    });
+  }
+
+  ~RecordingServer()
+  {
+    // connections are destroyed in this loop
+    inLoop([this] { server_.reset(); });
+    drain(loop_);
+  }
+
+  EventLoop* loop() const { return loop_; }
+
+  void inLoop(const std::function<void()>& f)
+  {
+    CountDownLatch latch(1);
+    loop_->runInLoop([&] { f(); latch.countDown(); });
+    latch.wait();
+  }
+
+  // 让 loop 停在一个回调中，直到 release()
+  void hold()
+  {
+    held_.reset(new CountDownLatch(1));
+    CountDownLatch entered(1);
+    CountDownLatch* held = get_pointer(held_);
+    loop_->runInLoop([&entered, held] {
+      entered.countDown();
+      held->wait();
+    });
+    entered.wait();
+  }
+
+  void release()
+  {
+    held_->countDown();
+  }
+
+  int64_t deferredCount()
+  {
+    int64_t count = 0;
+    inLoop([&] { count = loop_->deferredCount(); });
+    return count;
+  }
+
+  // 等到读够 bytes 字节，最多 10 秒
+  bool waitForBytes(size_t bytes)
+  {
+    for (int i = 0; i < 10000; ++i)
+    {
+      {
+      MutexLockGuard lock(mutex_);
+      if (bytes_ >= bytes)
+      {
+        return true;
+      }
+      }
+      ::usleep(1000);
+    }
+    return false;
+  }
+
+  size_t bytes() const
+  {
+    MutexLockGuard lock(mutex_);
+    return bytes_;
+  }
+
+  int callbacks() const
+  {
+    MutexLockGuard lock(mutex_);
+    return callbacks_;
+  }
+
+  // number of iterations which read something
+  size_t iterations() const
+  {
+    MutexLockGuard lock(mutex_);
+    return iterations_.size();
+  }
+
+  // most bytes read in one iteration
+  size_t maxBytesPerIteration() const
+  {
+    MutexLockGuard lock(mutex_);
+    size_t most = 0;
+    for (const auto& item : iterations_)
+    {
+      most = std::max(most, item.second);
+    }
+    return most;
+  }
+
+ private:
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    bool reply = false;
+    {
+    MutexLockGuard lock(mutex_);
+    const size_t old = bytes_;
+    bytes_ += buf->readableBytes();
+    ++callbacks_;
+    iterations_[loop_->iteration()] += buf->readableBytes();
+    reply = options_.replyBytes > 0 && old < options_.replyAfter
+         && bytes_ >= options_.replyAfter;
+    }
+    buf->retrieveAll();
+    if (options_.callbackMicros > 0)
+    {
+      Timestamp start(Timestamp::now());
+      while (Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()
+             < options_.callbackMicros)
+      {
+      }
+    }
+    if (reply)
+    {
+      conn->send(string(options_.replyBytes, 'r'));
+    }
+  }
+
+  const Options options_;
+  EventLoopThread thread_;
+  EventLoop* loop_;
+  std::unique_ptr<TcpServer> server_;
+  std::unique_ptr<CountDownLatch> held_;
+  mutable MutexLock mutex_;
+  size_t bytes_ GUARDED_BY(mutex_);
+  int callbacks_ GUARDED_BY(mutex_);
+  std::map<int64_t, size_t> iterations_ GUARDED_BY(mutex_);
+};
+
+// 不阻塞地写到 socket 满为止
+size_t fillSocket(int sockfd)
+{
+  const int flags = ::fcntl(sockfd, F_GETFL, 0);
+  ::fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+  const string chunk(64*1024, 'f');
+  size_t total = 0;
+  ssize_t n = 0;
+  while ((n = ::write(sockfd, chunk.data(), chunk.size())) > 0)
+  {
+    total += n;
+  }
+  assert(errno == EAGAIN);
+  ::fcntl(sockfd, F_SETFL, flags);
+  return total;
+}
+
+// 边沿触发：一次事件读到 EAGAIN；用完 eventBudget 时推迟到下一轮继续读，
+// 否则剩下的数据不会再有事件，连接就此停住。写也一样。
+void testEdgeTriggered(uint16_t port)
+{
+  printf("EdgeTriggered:\n");
+  // 预算足够大：一次事件读完已经到达的所有数据
+  {
+  RecordingServer::Options options;
+  options.edgeTriggered = true;
+  options.eventBudget = 64*1024*1024;
+  RecordingServer server(port, options);
+  int sockfd = connectTo(port);
+  const int64_t deferred = server.deferredCount();
+  server.hold();
+  const size_t filled = fillSocket(sockfd);
+  server.release();
+  assert(server.waitForBytes(filled));
+  printf("read %zu bytes in %zu iterations, %d callbacks\n",
+         filled, server.iterations(), server.callbacks());
+  // more than one read of 64KiB, all in one event
+  assert(filled > 128*1024);
+  assert(server.callbacks() > 1);
+  assert(server.iterations() == 1);
+  assert(server.deferredCount() == deferred);
+  ::close(sockfd);
+  }
+
+  // 预算小：分几轮读完，写也分几轮写完
+  {
+  const size_t kBudget = 16*1024;
+  const size_t kReply = 8*1024*1024;
+  RecordingServer::Options options;
+  options.edgeTriggered = true;
+  options.eventBudget = kBudget;
+  // the client reads the reply after the server has read everything
+  options.replyAfter = 1;
+  options.replyBytes = kReply;
+  RecordingServer server(port, options);
+  int sockfd = connectTo(port);
+  const int64_t deferred = server.deferredCount();
+  server.hold();
+  const size_t filled = fillSocket(sockfd);
+  server.release();
+  // nothing more is written, the rest is only read if the channel was deferred
+  assert(server.waitForBytes(filled));
+  const int64_t readDeferred = server.deferredCount() - deferred;
+  printf("read %zu bytes in %zu iterations, at most %zu, deferred %ld times\n",
+         filled, server.iterations(), server.maxBytesPerIteration(),
+         static_cast<long>(readDeferred));
+  assert(server.iterations() > 1);
+  assert(readDeferred > 0);
+
+  const int64_t written = server.deferredCount();
+  assert(readExactly(sockfd, kReply) == string(kReply, 'r'));
+  const int64_t writeDeferred = server.deferredCount() - written;
+  printf("wrote %zu bytes, deferred %ld times\n", kReply, static_cast<long>(writeDeferred));
+  assert(writeDeferred > 0);
+  ::close(sockfd);
+  }
+}
+
+struct BudgetResult
+{
+  size_t filled;
+  int callbacks;
+  size_t iterations;
+  int64_t deferred;
+};
+
+// 服务器 loop 暂停时客户端写满 socket，然后读完
+BudgetResult readFilled(uint16_t port, const RecordingServer::Options& options)
+{
+  RecordingServer server(port, options);
+  int sockfd = connectTo(port);
+  const int64_t deferred = server.deferredCount();
+  server.hold();
+  BudgetResult result;
+  result.filled = fillSocket(sockfd);
+  server.release();
+  assert(server.waitForBytes(result.filled));
+  result.callbacks = server.callbacks();
+  result.iterations = server.iterations();
+  result.deferred = server.deferredCount() - deferred;
+  printf("%zu bytes, %d callbacks in %zu iterations, deferred %ld times\n",
+         result.filled, result.callbacks, result.iterations,
+         static_cast<long>(result.deferred));
+  ::close(sockfd);
+  return result;
+}
+
+// 公平性预算：水平触发每个事件只读一次，超出字节或时间预算时计入 deferredCount()；
+// 边沿触发用完时间预算就停下，推迟到下一轮
+void testChannelBudget(uint16_t port)
+{
+  printf("ChannelBudget:\n");
+  RecordingServer::Options options;
+  // 没有预算
+  BudgetResult result = readFilled(port, options);
+  assert(result.callbacks == static_cast<int>(result.iterations));
+  assert(result.deferred == 0);
+
+  // 字节预算，每次读的都超过它
+  options.channelBytes = 1;
+  result = readFilled(port, options);
+  assert(result.callbacks == static_cast<int>(result.iterations));
+  assert(result.deferred == result.callbacks);
+
+  // 时间预算，每次回调都超过它
+  options.channelBytes = 0;
+  options.channelMicros = 500;
+  options.callbackMicros = 1000;
+  result = readFilled(port, options);
+  assert(result.callbacks == static_cast<int>(result.iterations));
+  assert(result.deferred == result.callbacks);
+
+  // 边沿触发，一次回调就用完时间预算
+  options.edgeTriggered = true;
+  options.eventBudget = 64*1024*1024;
+  result = readFilled(port, options);
+  assert(result.callbacks == static_cast<int>(result.iterations));
+  assert(result.deferred >= result.callbacks - 1);
+}
+
+// 回显到 '!' 为止，然后关闭写端
+void onEchoUntilBang(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  const char* end = buf->peek() + buf->readableBytes();
+  const char* bang = std::find(buf->peek(), end, '!');
+  if (bang == end)
+  {
+    conn->send(buf);
+  }
+  else
+  {
+    conn->send(buf->peek(), static_cast<int>(bang + 1 - buf->peek()));
+    buf->retrieveAll();
+    conn->shutdown();
+  }
+}
+
+// 完成模式：回显的数据完整且有序，sendmsg 部分完成时也一样；EOF 和关闭正常
+void testCompletionMode(uint16_t port)
+{
+  printf("CompletionMode:\n");
+  if (!IoUringPoller::isSupported())
+  {
+    printf("io_uring is not available, skipped\n");
+    return;
+  }
+  // the environment is read when an EventLoop creates its poller
+  ::setenv("MUDUO_USE_IO_URING", "1", 1);
+  EventLoopThread ioThread;
+  EventLoop* loop = ioThread.startLoop();
+  ::unsetenv("MUDUO_USE_IO_URING");
+  assert(loop->ioUringPoller() != NULL);
+
+  std::unique_ptr<TcpServer> server;
+  std::atomic<bool> completion(false);
+  CountDownLatch disconnected(1);
+  CountDownLatch started(1);
+  loop->runInLoop([&] {
+    server.reset(new TcpServer(loop, InetAddress(port, true), "completion"));
+    server->setCompletionMode(true);
+    server->setConnectionCallback([&](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        completion = conn->completionMode();
+      }
+      else
+      {
+        disconnected.countDown();
+      }
+    });
+    server->setMessageCallback(onEchoUntilBang);
+    server->start();
+    started.countDown();
+  });
+  started.wait();
+
+  // the client doesn't read at first, so the echo backs up in sendmsg
+  const size_t kBytes = 16*1024*1024;
+  int sockfd = connectTo(port, 64*1024);
+  Thread writer([sockfd, kBytes] {
+    string chunk(64*1024, '\0');
+    for (size_t sent = 0; sent < kBytes; sent += chunk.size())
+    {
+      for (size_t i = 0; i < chunk.size(); ++i)
+      {
+        chunk[i] = static_cast<char>('a' + (sent + i) % 26);
+      }
+      writeAll(sockfd, chunk);
+    }
+    writeAll(sockfd, "!");
+  });
+  writer.start();
+  ::usleep(100*1000);
+
+  char buf[65536];
+  size_t received = 0;
+  ssize_t n = 0;
+  bool intact = true;
+  while ((n = ::read(sockfd, buf, sizeof buf)) > 0)
+  {
+    for (ssize_t i = 0; i < n; ++i, ++received)
+    {
+      const char expected = received < kBytes ? static_cast<char>('a' + received % 26) : '!';
+      intact = intact && buf[i] == expected;
+    }
+  }
+  writer.join();
+  printf("echoed %zu bytes, completion mode %d\n", received, completion.load());
+  // the server shut down after the echo
+  assert(n == 0);
+  assert(intact);
+  assert(received == kBytes + 1);
+  assert(completion);
+
+  // EOF from the client closes the connection
+  ::close(sockfd);
+  disconnected.wait();
+  CountDownLatch stopped(1);
+  loop->runInLoop([&] {
+    server.reset();
+    stopped.countDown();
+  });
+  stopped.wait();
+}
+
+std::vector<std::weak_ptr<const string>> g_payloads;
+
+// 发送若干零拷贝 payload 后立即关闭
+void onZeroCopyConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setZeroCopyThreshold();
+    for (int i = 0; i < 16; ++i)
+    {
+      SharedPayload payload(new string(1024*1024, 'z'));
+      g_payloads.push_back(payload);
+      conn->send(payload);
+    }
+    conn->forceClose();
+  }
+  else
+  {
+    g_disconnected->countDown();
+  }
+}
+
+int numAlive()
+{
+  int alive = 0;
+  for (const auto& payload : g_payloads)
+  {
+    alive += !payload.expired();
+  }
+  return alive;
+}
+
+// 连接销毁后，内核还没有发送的 payload 仍然被持有，直到完成通知到达
+void testZeroCopyLinger(uint16_t port)
+{
+  printf("ZeroCopyLinger:\n");
+  g_disconnected.reset(new CountDownLatch(1));
+  runInBaseLoop([&] {
+    g_server.reset(new TcpServer(g_baseLoop, InetAddress(port, true), "zerocopy"));
+    g_server->setConnectionCallback(onZeroCopyConnection);
+    g_server->start();
+  });
+  int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int rcvbuf = 64*1024;
+  ::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  struct sockaddr_in addr;
+  memZero(&addr, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int ret = ::connect(sockfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+  assert(ret == 0); (void)ret;
+  // the peer doesn't read, so the tail of what was sent stays in the send queue
+  g_disconnected->wait();
+  drain(g_baseLoop);
+  drain(g_baseLoop);
+  int pinned = numAlive();
+  printf("pinned %d after destroyed\n", pinned);
+  assert(pinned > 0);
+
+  // reading lets the kernel finish, then the socket closes
+  char buf[65536];
+  ssize_t n = 0;
+  size_t total = 0;
+  while ((n = ::read(sockfd, buf, sizeof buf)) > 0)
+  {
+    total += n;
+  }
+  printf("read %zu bytes\n", total);
+  assert(n == 0);
+  assert(numAlive() == 0);
+  ::close(sockfd);
+  runInBaseLoop([] { g_server.reset(); });
+  g_payloads.clear();
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoopThread baseThread;
+  g_baseLoop = baseThread.startLoop();
+  testMigrate(29871);
+  testRebalance(29872);
+  testListenPerLoop();
+  testSendFromOtherThread(29875);
+  testSendvPartial(29880);
+  testWriteCoalescing(29876);
+  testEdgeTriggered(29877);
+  testChannelBudget(29878);
+  testCompletionMode(29879);
+  testZeroCopyLinger(29874);
+  printf("done\n");
+}
@@ -0,0 +1,140 @@
+// 连接建立和关闭的吞吐量：base loop 统一 accept，对比每个 IO loop 各自 accept
+
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 23460;
+
+void discardOutput(const char*, int)
+{
+}
+
+// 连接，1 字节往返，RST 关闭，客户端不留 TIME_WAIT
+bool churnOnce(const InetAddress& serverAddr)
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  struct linger abortive = { 1, 0 };
+  ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &abortive, sizeof abortive);
+  bool ok = false;
+  if (::connect(fd, serverAddr.getSockAddr(), sizeof(struct sockaddr_in)) == 0)
+  {
+    char c = 'x';
+    ok = ::write(fd, &c, 1) == 1 && ::read(fd, &c, 1) == 1;
+  }
+  ::close(fd);
+  return ok;
+}
+
+void churn(TcpServer::Option option, uint16_t port,
+           int numThreads, int numClients, double seconds)
+{
+  EventLoopThread baseThread;
+  EventLoop* baseLoop = baseThread.startLoop();
+  InetAddress listenAddr(port, true);
+  std::unique_ptr<TcpServer> server;
+  std::vector<EventLoop*> loops;
+  CountDownLatch started(1);
+  baseLoop->runInLoop([&] {
+    server.reset(new TcpServer(baseLoop, listenAddr, "ChurnServer", option));
+    server->setThreadNum(numThreads);
+    server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+      conn->send(buf);
+    });
+    server->start();
+    loops = server->threadPool()->getAllLoops();
+    started.countDown();
+  });
+  started.wait();
+  // listen() runs in the IO loops
+  ::usleep(100*1000);
+
+  std::atomic<int64_t> connections(0);
+  std::atomic<int64_t> failures(0);
+  Timestamp start(Timestamp::now());
+  std::vector<std::unique_ptr<Thread>> clients;
+  for (int i = 0; i < numClients; ++i)
+  {
+    clients.emplace_back(new Thread([&] {
+      int64_t n = 0;
+      int64_t failed = 0;
+      while (timeDifference(Timestamp::now(), start) < seconds)
+      {
+        if (churnOnce(listenAddr))
+        {
+          ++n;
+        }
+        else
+        {
+          ++failed;
+        }
+      }
+      connections += n;
+      failures += failed;
+    }));
+    clients.back()->start();
+  }
+  for (const auto& client : clients)
+  {
+    client->join();
+  }
+  double elapsed = timeDifference(Timestamp::now(), start);
+
+  // 等服务端的连接都销毁后再析构 TcpServer
+  for (EventLoop* loop : loops)
+  {
+    while (loop->numConnections() > 0)
+    {
+      ::usleep(1000);
+    }
+  }
+  CountDownLatch stopped(1);
+  baseLoop->runInLoop([&] {
+    server.reset();
+    stopped.countDown();
+  });
+  stopped.wait();
+
+  printf("%-20s threads %d clients %d  %9.0f conns/s  failed %ld\n",
+         option == TcpServer::kReusePortPerLoop ? "accept per loop" : "accept in base loop",
+         numThreads, numClients,
+         static_cast<double>(connections.load()) / elapsed,
+         static_cast<long>(failures.load()));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+  int numClients = argc > 2 ? atoi(argv[2]) : numThreads;
+  double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+  Logger::setLogLevel(Logger::WARN);
+  // every RST shows up in TcpConnection::handleError
+  Logger::setOutput(discardOutput);
+
+  churn(TcpServer::kReusePort, kPort, numThreads, numClients, seconds);
+  churn(TcpServer::kReusePortPerLoop, kPort + 1, numThreads, numClients, seconds);
+}
@@ -0,0 +1,122 @@
+#include "muduo/net/TimerHeap.h"
+#include "muduo/net/Timer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using muduo::Timestamp;
+using namespace muduo::net;
+
+namespace
+{
+
+typedef std::unique_ptr<Timer> TimerPtr;
+
+TimerPtr newTimer(int64_t microseconds)
+{
+  return TimerPtr(new Timer(TimerCallback(), Timestamp(microseconds), 0.0));
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testTimerHeapOrder)
+{
+  std::mt19937 random(1);
+  TimerHeap heap;
+  std::vector<TimerPtr> timers;
+  std::set<std::pair<Timestamp, Timer*>> reference;
+  for (int i = 0; i < 10000; ++i)
+  {
+    timers.push_back(newTimer(1 + random() % 100000));
+    Timer* timer = get_pointer(timers.back());
+    bool earliest = reference.empty() || timer->expiration() < reference.begin()->first;
+    // equal expirations may go either way
+    bool tie = !reference.empty() && timer->expiration() == reference.begin()->first;
+    bool added = heap.add(timer);
+    BOOST_CHECK(tie || added == earliest);
+    reference.insert(std::make_pair(timer->expiration(), timer));
+    BOOST_CHECK(timer->queued());
+  }
+
+  // 随机删除一半
+  for (size_t i = 0; i < timers.size(); i += 2)
+  {
+    Timer* timer = get_pointer(timers[i]);
+    heap.remove(timer);
+    reference.erase(std::make_pair(timer->expiration(), timer));
+    BOOST_CHECK(!timer->queued());
+  }
+  BOOST_CHECK_EQUAL(heap.size(), reference.size());
+
+  std::vector<Timer*> expired;
+  for (int64_t now = 0; !reference.empty(); now += 997)
+  {
+    expired.clear();
+    heap.popExpired(Timestamp(now), &expired);
+    for (Timer* timer : expired)
+    {
+      BOOST_REQUIRE(!reference.empty());
+      BOOST_CHECK(timer->expiration() == reference.begin()->first);
+      BOOST_CHECK_LE(timer->expiration().microSecondsSinceEpoch(), now);
+      reference.erase(std::make_pair(timer->expiration(), timer));
+    }
+    BOOST_CHECK(reference.empty() || now < reference.begin()->first.microSecondsSinceEpoch());
+    BOOST_CHECK(heap.nextExpiration() == (reference.empty() ? Timestamp::invalid()
+                                                            : reference.begin()->first));
+  }
+  BOOST_CHECK_EQUAL(heap.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testTimerHeapTakeAll)
+{
+  TimerHeap heap;
+  std::vector<TimerPtr> timers;
+  for (int i = 0; i < 100; ++i)
+  {
+    timers.push_back(newTimer(1000 - i));
+    heap.add(get_pointer(timers.back()));
+  }
+  std::vector<Timer*> all;
+  heap.takeAll(&all);
+  BOOST_CHECK_EQUAL(all.size(), 100u);
+  BOOST_CHECK_EQUAL(heap.size(), 0u);
+  for (const TimerPtr& timer : timers)
+  {
+    BOOST_CHECK(!timer->queued());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testTimerSlack)
+{
+  BOOST_CHECK_EQUAL(Timer::gridOf(0.0), 0);
+  BOOST_CHECK_EQUAL(Timer::gridOf(0.001), 512);
+  BOOST_CHECK_EQUAL(Timer::gridOf(0.1), 65536);
+
+  std::mt19937 random(2);
+  for (int i = 0; i < 10000; ++i)
+  {
+    double slack = static_cast<double>(random() % 1000000) / 1e6;
+    int64_t grid = Timer::gridOf(slack);
+    Timestamp when(1000000000000000 + random() % 100000000);
+    Timestamp expiration = Timer::coalesce(when, grid);
+    // never early, at most slack late, on the grid
+    BOOST_CHECK(!(expiration < when));
+    BOOST_CHECK_LE(timeDifference(expiration, when), slack);
+    if (grid > 0)
+    {
+      BOOST_CHECK_EQUAL(expiration.microSecondsSinceEpoch() % grid, 0);
+    }
+  }
+
+  // the same boundary for nearby timers
+  Timer t1(TimerCallback(), Timestamp(1000000000000000 + 1000), 0.0, 0.1);
+  Timer t2(TimerCallback(), Timestamp(1000000000000000 + 30000), 0.0, 0.1);
+  BOOST_CHECK(t1.expiration() == t2.expiration());
+}
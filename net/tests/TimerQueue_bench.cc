@@ -0,0 +1,178 @@
+// 时间器压力测试：大量短时间器不断到期并重新添加（类似请求超时）
+// compares the timerfd mode with the poll timeout mode of EventLoop,
+// and the timer heap with the timing wheel.
+// 另外测试大量常驻时间器时的添加/取消（类似连接的空闲超时被不断推迟）
+// 以及带松弛时间的周期时间器合并唤醒的效果
+
+#include "muduo/net/EventLoop.h"
+#include "muduo/base/Timestamp.h"
+
+#include <random>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+double cpuSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+// numTimers 个时间器，每个到期后以随机的延时重新添加
+class Rearm
+{
+ public:
+  Rearm(EventLoop* loop, int numTimers, double maxDelay)
+    : loop_(loop),
+      maxDelay_(maxDelay),
+      random_(42),
+      fires_(0),
+      late_(0)
+  {
+    for (int i = 0; i < numTimers; ++i)
+    {
+      add();
+    }
+  }
+
+  int64_t fires() const { return fires_; }
+  double averageLate() const { return fires_ ? late_ / static_cast<double>(fires_) : 0; }
+
+ private:
+  void add()
+  {
+    std::uniform_real_distribution<double> delay(0, maxDelay_);
+    Timestamp when(addTime(Timestamp::now(), delay(random_)));
+    loop_->runAt(when, [this, when] {
+      ++fires_;
+      late_ += timeDifference(Timestamp::now(), when);
+      add();
+    });
+  }
+
+  EventLoop* loop_;
+  const double maxDelay_;
+  std::mt19937 random_;
+  int64_t fires_;
+  double late_;
+};
+
+const int64_t kWheelTick = 1000;
+
+const char* nameOf(int64_t wheelTick)
+{
+  return wheelTick > 0 ? "wheel" : "heap";
+}
+
+void bench(EventLoop::TimerMode mode, int64_t wheelTick,
+           int numTimers, double maxDelay, double seconds)
+{
+  EventLoop loop;
+  loop.setTimerMode(mode);
+  loop.setTimerWheel(wheelTick);
+  Rearm rearm(&loop, numTimers, maxDelay);
+  loop.runAfter(seconds, [&loop] { loop.quit(); });
+
+  double cpu = cpuSeconds();
+  int64_t iterations = loop.iteration();
+  loop.loop();
+  cpu = cpuSeconds() - cpu;
+  iterations = loop.iteration() - iterations;
+  printf("%-6s %-13s %10.0f fires/s %8.2f us cpu/fire %8ld iterations %8.3f ms late\n",
+         nameOf(wheelTick),
+         mode == EventLoop::kTimerfd ? "timerfd" : "poll timeout",
+         static_cast<double>(rearm.fires()) / seconds,
+         cpu * 1e6 / static_cast<double>(rearm.fires()),
+         static_cast<long>(iterations),
+         rearm.averageLate() * 1000);
+}
+
+// 每次取消一个常驻时间器并添加一个新的
+void churn(int64_t wheelTick, int numResident, int numOps)
+{
+  EventLoop loop;
+  loop.setTimerWheel(wheelTick);
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> delay(10, 70);
+  std::vector<TimerId> timers;
+  timers.reserve(numResident);
+  // called in the loop thread, addTimer() and cancel() run right away
+  for (int i = 0; i < numResident; ++i)
+  {
+    timers.push_back(loop.runAfter(delay(random), [] {}));
+  }
+
+  double cpu = cpuSeconds();
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < numOps; ++i)
+  {
+    TimerId& timer = timers[random() % numResident];
+    loop.cancel(timer);
+    timer = loop.runAfter(delay(random), [] {});
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  cpu = cpuSeconds() - cpu;
+  printf("%-6s %d resident timers %10.0f add+cancel/s %8.1f ns cpu each\n",
+         nameOf(wheelTick), numResident,
+         static_cast<double>(numOps) / seconds,
+         cpu * 1e9 / static_cast<double>(numOps));
+}
+
+// 每个连接一个 1~2 秒的周期时间器，比较有无 slack 时的唤醒次数
+void coalescing(double slack, int numTimers, double seconds)
+{
+  EventLoop loop;
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> interval(1, 2);
+  int64_t fires = 0;
+  for (int i = 0; i < numTimers; ++i)
+  {
+    loop.runEvery(interval(random), slack, [&fires] { ++fires; });
+  }
+  loop.runAfter(seconds, [&loop] { loop.quit(); });
+
+  double cpu = cpuSeconds();
+  int64_t iterations = loop.iteration();
+  loop.loop();
+  cpu = cpuSeconds() - cpu;
+  iterations = loop.iteration() - iterations;
+  printf("slack %5.3f s %6d periodic timers %8.0f fires/s %8.0f wakeups/s %6.1f%% cpu\n",
+         slack, numTimers,
+         static_cast<double>(fires) / seconds,
+         static_cast<double>(iterations) / seconds,
+         cpu * 100 / seconds);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  int numTimers = argc > 1 ? atoi(argv[1]) : 1000;
+  double maxDelay = argc > 2 ? atof(argv[2]) : 0.01;
+  double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+  int numResident = argc > 4 ? atoi(argv[4]) : 1000000;
+
+  printf("%d timers, delays up to %.3f s\n", numTimers, maxDelay);
+  for (int64_t wheelTick : { int64_t(0), kWheelTick })
+  {
+    bench(EventLoop::kTimerfd, wheelTick, numTimers, maxDelay, seconds);
+    bench(EventLoop::kPollTimeout, wheelTick, numTimers, maxDelay, seconds);
+  }
+  for (int64_t wheelTick : { int64_t(0), kWheelTick })
+  {
+    churn(wheelTick, numResident, 2000000);
+  }
+  for (double slack : { 0.0, 0.01, 0.1 })
+  {
+    coalescing(slack, 20000, seconds);
+  }
+}
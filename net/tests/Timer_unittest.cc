@@ -0,0 +1,227 @@
+// 时钟模式下的时间器：不提前到期，也不反复唤醒
+// kPollTimeout 模式：没有 timerfd，由 poll 超时驱动时间器
+
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+
+#include <atomic>
+#include <random>
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char* modeName(EventLoop::ClockMode mode)
+{
+  return mode == EventLoop::kPreciseClock ? "precise"
+       : mode == EventLoop::kCachedClock ? "cached" : "coarse";
+}
+
+// runAfter() in the loop thread counts from now(), the timer must not
+// run before that plus the delay by the precise clock
+void testNeverEarly(EventLoop::ClockMode mode)
+{
+  EventLoopThread thread([mode](EventLoop* loop) { loop->setClockMode(mode); });
+  EventLoop* loop = thread.startLoop();
+
+  const int kTimers = 200;
+  CountDownLatch latch(kTimers);
+  std::atomic<int> early(0);
+  std::atomic<int64_t> maxLate(0);
+  std::mt19937 random(static_cast<unsigned>(mode));
+  for (int i = 0; i < kTimers; ++i)
+  {
+    const double delay = static_cast<double>(random() % 20000) / 1e6;
+    loop->runInLoop([&, loop, delay] {
+      Timestamp expiration = addTime(loop->now(), delay);
+      loop->runAfter(delay, [&, expiration] {
+        int64_t late = Timestamp::now().microSecondsSinceEpoch()
+                     - expiration.microSecondsSinceEpoch();
+        if (late < 0)
+        {
+          ++early;
+        }
+        else if (late > maxLate)
+        {
+          maxLate = late;
+        }
+        latch.countDown();
+      });
+    });
+    if (i % 10 == 0)
+    {
+      ::usleep(static_cast<useconds_t>(random() % 3000));
+    }
+  }
+  latch.wait();
+  printf("%-8s early %d, at most %ld us late\n", modeName(mode),
+         early.load(), static_cast<long>(maxLate.load()));
+  assert(early == 0);
+}
+
+// an idle loop with one timer wakes up for it once, not until the coarse
+// clock catches up with the expiration
+void testWakeups(EventLoop::ClockMode mode)
+{
+  EventLoopThread thread([mode](EventLoop* loop) { loop->setClockMode(mode); });
+  EventLoop* loop = thread.startLoop();
+
+  const int kRounds = 20;
+  int64_t maxIterations = 0;
+  for (int i = 0; i < kRounds; ++i)
+  {
+    CountDownLatch latch(1);
+    int64_t start = 0;
+    int64_t fired = 0;
+    loop->runInLoop([&] {
+      start = loop->iteration();
+      loop->runAfter(0.005 + 0.0003 * i, [&] {
+        fired = loop->iteration();
+        latch.countDown();
+      });
+    });
+    latch.wait();
+    if (fired - start > maxIterations)
+    {
+      maxIterations = fired - start;
+    }
+  }
+  printf("%-8s at most %ld iterations for a timer\n", modeName(mode),
+         static_cast<long>(maxIterations));
+  // the timer and maybe a wakeup from the next runInLoop()
+  assert(maxIterations <= 2);
+}
+
+int countTimerfds()
+{
+  int count = 0;
+  DIR* dir = ::opendir("/proc/self/fd");
+  assert(dir);
+  while (struct dirent* entry = ::readdir(dir))
+  {
+    char path[300];
+    char target[64] = "";
+    snprintf(path, sizeof path, "/proc/self/fd/%s", entry->d_name);
+    if (::readlink(path, target, sizeof target - 1) > 0
+        && strstr(target, "timerfd"))
+    {
+      ++count;
+    }
+  }
+  ::closedir(dir);
+  return count;
+}
+
+void testPollTimeout()
+{
+  EventLoopThread thread([](EventLoop* loop) {
+    loop->setTimerMode(EventLoop::kPollTimeout);
+  });
+  EventLoop* loop = thread.startLoop();
+  assert(loop->timerMode() == EventLoop::kPollTimeout);
+  assert(countTimerfds() == 0);
+
+  // 在循环线程中添加，没有 timerfd 也按时到期
+  {
+    CountDownLatch latch(1);
+    Timestamp fired;
+    Timestamp start = Timestamp::now();
+    loop->runInLoop([&] {
+      loop->runAfter(0.02, [&] {
+        fired = Timestamp::now();
+        latch.countDown();
+      });
+    });
+    latch.wait();
+    double elapsed = timeDifference(fired, start);
+    printf("loop thread timer after %.3fs\n", elapsed);
+    assert(elapsed >= 0.02 && elapsed < 1.0);
+  }
+
+  // 其他线程添加，唤醒阻塞在无限期 poll 中的循环
+  {
+    ::usleep(100 * 1000);
+    int64_t iteration = loop->iteration();
+    CountDownLatch latch(1);
+    Timestamp fired;
+    Timestamp start = Timestamp::now();
+    loop->runAfter(0.03, [&] {
+      fired = Timestamp::now();
+      latch.countDown();
+    });
+    latch.wait();
+    double elapsed = timeDifference(fired, start);
+    printf("cross-thread timer after %.3fs, %ld iterations\n",
+           elapsed, static_cast<long>(loop->iteration() - iteration));
+    assert(elapsed >= 0.03 && elapsed < 1.0);
+  }
+
+  // runEvery 每次到期后重新调度
+  {
+    const int kTimes = 5;
+    CountDownLatch latch(kTimes);
+    std::atomic<int> count(0);
+    Timestamp start = Timestamp::now();
+    TimerId id = loop->runEvery(0.01, [&] {
+      ++count;
+      latch.countDown();
+    });
+    latch.wait();
+    double elapsed = timeDifference(Timestamp::now(), start);
+    loop->cancel(id);
+    ::usleep(50 * 1000);
+    int after = count;
+    ::usleep(50 * 1000);
+    printf("runEvery %d times in %.3fs\n", after, elapsed);
+    assert(elapsed >= 0.01 * kTimes);
+    assert(count == after);
+  }
+
+  // 回调中取消自己和另一个时间器
+  {
+    CountDownLatch latch(1);
+    std::atomic<int> count(0);
+    std::atomic<int> other(0);
+    TimerId self;
+    TimerId victim;
+    loop->runInLoop([&] {
+      victim = loop->runAfter(0.08, [&] { ++other; });
+      self = loop->runEvery(0.01, [&] {
+        if (++count == 3)
+        {
+          loop->cancel(self);
+          loop->cancel(victim);
+          latch.countDown();
+        }
+      });
+    });
+    latch.wait();
+    ::usleep(100 * 1000);
+    printf("cancelled in callback after %d times, other ran %d times\n",
+           count.load(), other.load());
+    assert(count == 3);
+    assert(other == 0);
+  }
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  const EventLoop::ClockMode modes[] = {
+    EventLoop::kPreciseClock, EventLoop::kCachedClock, EventLoop::kCoarseClock
+  };
+  for (EventLoop::ClockMode mode : modes)
+  {
+    testNeverEarly(mode);
+    testWakeups(mode);
+  }
+  testPollTimeout();
+  printf("done\n");
+}
@@ -0,0 +1,148 @@
+#include "muduo/net/TimingWheel.h"
+#include "muduo/net/Timer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using muduo::Timestamp;
+using namespace muduo::net;
+
+namespace
+{
+
+const int64_t kStart = int64_t(1000000000) * Timestamp::kMicroSecondsPerSecond;
+
+Timestamp at(int64_t microseconds)
+{
+  return Timestamp(kStart + microseconds);
+}
+
+typedef std::unique_ptr<Timer> TimerPtr;
+
+TimerPtr newTimer(int64_t microseconds)
+{
+  return TimerPtr(new Timer(TimerCallback(), at(microseconds), 0.0));
+}
+
+// 随机推进时间，检查每个时间器都在第一个可能的时刻到期
+void checkRandom(int64_t tick, int64_t maxDelay, int64_t maxStep, int numTimers)
+{
+  std::mt19937_64 random(tick + maxDelay);
+  TimingWheel wheel(at(0), tick);
+  std::vector<TimerPtr> timers;
+  std::set<std::pair<Timestamp, Timer*>> pending;
+  for (int i = 0; i < numTimers; ++i)
+  {
+    timers.push_back(newTimer(static_cast<int64_t>(random() % maxDelay)));
+    wheel.add(get_pointer(timers.back()));
+    pending.insert(std::make_pair(timers.back()->expiration(), get_pointer(timers.back())));
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), pending.size());
+
+  int64_t now = 0;
+  std::vector<Timer*> expired;
+  while (!pending.empty())
+  {
+    Timestamp earliest = pending.begin()->first;
+    // the wheel may wake up early for a cascade, never late
+    BOOST_CHECK_LT(wheel.nextExpiration().microSecondsSinceEpoch(),
+                   earliest.microSecondsSinceEpoch() + tick);
+
+    int64_t previous = now;
+    now += static_cast<int64_t>(random() % maxStep);
+    expired.clear();
+    wheel.advance(at(now), &expired);
+    int64_t lastTick = 0;
+    for (Timer* timer : expired)
+    {
+      BOOST_REQUIRE_EQUAL(pending.erase(std::make_pair(timer->expiration(), timer)), 1u);
+      int64_t expiration = timer->expiration().microSecondsSinceEpoch() - kStart;
+      BOOST_CHECK_LE(expiration, now);
+      BOOST_CHECK_LT(previous, expiration + tick);
+      // in tick order
+      int64_t expires = (expiration + tick - 1) / tick;
+      BOOST_CHECK_LE(lastTick, expires);
+      lastTick = expires;
+    }
+    BOOST_CHECK_EQUAL(wheel.size(), pending.size());
+  }
+  BOOST_CHECK(!wheel.nextExpiration().valid());
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testTimingWheelLevel0)
+{
+  checkRandom(1000, 200 * 1000, 3000, 10000);
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelCascade)
+{
+  // up to level 2 with 1ms ticks
+  checkRandom(1000, 300 * 1000 * 1000, 200 * 1000, 20000);
+  // all levels
+  checkRandom(1, 100 * 1000 * 1000, 50 * 1000, 20000);
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelRemove)
+{
+  TimingWheel wheel(at(0), 1000);
+  std::vector<TimerPtr> timers;
+  for (int i = 0; i < 1000; ++i)
+  {
+    timers.push_back(newTimer(i * 1000));
+    wheel.add(get_pointer(timers.back()));
+  }
+  for (int i = 0; i < 1000; i += 2)
+  {
+    wheel.remove(get_pointer(timers[i]));
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 500u);
+  std::vector<Timer*> expired;
+  wheel.advance(at(1000 * 1000), &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 500u);
+  for (size_t i = 0; i < expired.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(expired[i], get_pointer(timers[2 * i + 1]));
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelAddReturnsEarliest)
+{
+  TimingWheel wheel(at(0), 1000);
+  TimerPtr t1(newTimer(50 * 1000));
+  TimerPtr t2(newTimer(80 * 1000));
+  TimerPtr t3(newTimer(10 * 1000 * 1000));
+  TimerPtr t4(newTimer(20 * 1000));
+  BOOST_CHECK(wheel.add(get_pointer(t1)));
+  BOOST_CHECK(!wheel.add(get_pointer(t2)));
+  BOOST_CHECK(!wheel.add(get_pointer(t3)));
+  BOOST_CHECK(wheel.add(get_pointer(t4)));
+  BOOST_CHECK(wheel.nextExpiration() == at(20 * 1000));
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelBeyondRange)
+{
+  // 2^32 ticks is 71 minutes with 1us ticks
+  TimingWheel wheel(at(0), 1);
+  TimerPtr far(newTimer(int64_t(5000) * 1000 * 1000));
+  TimerPtr near(newTimer(1000));
+  wheel.add(get_pointer(far));
+  wheel.add(get_pointer(near));
+  std::vector<Timer*> expired;
+  wheel.advance(at(int64_t(4999) * 1000 * 1000), &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+  BOOST_CHECK_EQUAL(expired[0], get_pointer(near));
+  expired.clear();
+  wheel.advance(at(int64_t(5000) * 1000 * 1000), &expired);
+  BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+  BOOST_CHECK_EQUAL(expired[0], get_pointer(far));
+}